@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Math.h"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Mesure d'un noyau : mediane et minimum sur plusieurs repetitions, chacune assez longue
+// pour que la resolution de l'horloge soit negligeable
+struct BenchmarkResult {
+    std::string name;
+    std::string unit;        // ce que compte une operation : rays, pixels...
+    uint64_t operations = 0; // operations par repetition
+    double nsPerOp = 0;      // mediane
+    double minNsPerOp = 0;
+    double checksum = 0;     // somme des resultats, identique d'un commit a l'autre si le noyau n'a pas change de sens
+
+    double OpsPerSecond() const { return nsPerOp > 0 ? 1e9 / nsPerOp : 0.0; }
+};
+
+struct BenchmarkOptions {
+    double minSeconds = 0.05; // duree minimale d'une repetition
+    int repetitions = 5;
+    std::string filter;       // seuls les noyaux dont le nom contient filter sont mesures
+};
+
+// Barriere de compilation : les entrees d'un noyau peuvent avoir change en memoire, son appel
+// suivant ne peut donc pas etre remplace par le resultat du precedent
+inline void clobberMemory() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : : "memory");
+#endif
+}
+
+inline std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+// Description de la machine et du build, ecrite en tete du JSON
+inline std::vector<std::pair<std::string, std::string>> buildMetadata() {
+    std::vector<std::pair<std::string, std::string>> metadata;
+#if defined(_MSC_VER) && !defined(__clang__)
+    metadata.emplace_back("compiler", "msvc " + std::to_string(_MSC_VER));
+#elif defined(__clang__)
+    metadata.emplace_back("compiler", std::string("clang ") + __clang_version__);
+#elif defined(__GNUC__)
+    metadata.emplace_back("compiler", std::string("gcc ") + __VERSION__);
+#else
+    metadata.emplace_back("compiler", "unknown");
+#endif
+    metadata.emplace_back("real", sizeof(Real) == sizeof(float) ? "float" : "double");
+#if defined(__AVX2__)
+    metadata.emplace_back("simd", "avx2");
+#elif defined(__SSE2__) || defined(_M_X64)
+    metadata.emplace_back("simd", "sse2");
+#else
+    metadata.emplace_back("simd", "scalar");
+#endif
+#if defined(RAYTRACING_STATS)
+    metadata.emplace_back("stats", "on");
+#else
+    metadata.emplace_back("stats", "off");
+#endif
+    return metadata;
+}
+
+class BenchmarkRunner {
+private:
+    BenchmarkOptions options;
+    std::vector<BenchmarkResult> results;
+    volatile double sink = 0; // les resultats y sont accumules pour que rien ne soit elimine
+
+public:
+    explicit BenchmarkRunner(BenchmarkOptions options) : options(std::move(options)) {}
+
+    // fn() fait opsPerCall operations et renvoie la somme de leurs resultats. Elle est appelee
+    // autant de fois que necessaire pour atteindre minSeconds, puis repetitions fois ce nombre.
+    template <typename Fn>
+    void Run(const std::string& name, const std::string& unit, const uint64_t opsPerCall, Fn&& fn) {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+            return;
+        }
+        using Clock = std::chrono::steady_clock;
+
+        // echauffement et calibration
+        uint64_t calls = 1;
+        double checksum = 0;
+        for (;;) {
+            const auto start = Clock::now();
+            double sum = 0;
+            for (uint64_t c = 0; c < calls; ++c) {
+                sum += fn();
+                clobberMemory();
+            }
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            sink = sink + sum;
+            checksum = sum / static_cast<double>(calls);
+            if (seconds >= options.minSeconds) {
+                break;
+            }
+            calls = seconds > 0 ? std::max(calls * 2, static_cast<uint64_t>(static_cast<double>(calls) * options.minSeconds / seconds * 1.2)) : calls * 2;
+        }
+
+        std::vector<double> samples;
+        for (int r = 0; r < std::max(1, options.repetitions); ++r) {
+            const auto start = Clock::now();
+            double sum = 0;
+            for (uint64_t c = 0; c < calls; ++c) {
+                sum += fn();
+                clobberMemory();
+            }
+            const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            sink = sink + sum;
+            samples.push_back(ns / static_cast<double>(calls * opsPerCall));
+        }
+        std::sort(samples.begin(), samples.end());
+
+        BenchmarkResult result;
+        result.name = name;
+        result.unit = unit;
+        result.operations = calls * opsPerCall;
+        result.nsPerOp = samples[samples.size() / 2];
+        result.minNsPerOp = samples.front();
+        result.checksum = checksum;
+        results.push_back(result);
+    }
+
+    const std::vector<BenchmarkResult>& Results() const { return results; }
+
+    // Tableau lisible ; avec une reference, ajoute le rapport ancien / nouveau (> 1 = plus rapide)
+    void Print(std::ostream& out, const std::map<std::string, double>& baseline = {}) const {
+        const auto flags = out.flags();
+        const auto precision = out.precision();
+        out << std::left << std::setw(48) << "noyau" << std::right << std::setw(12) << "ns/op" << std::setw(12) << "min"
+            << std::setw(14) << "op/s" << (baseline.empty() ? "" : "   gain") << "\n";
+        for (const BenchmarkResult& result : results) {
+            out << std::left << std::setw(48) << result.name << std::right << std::fixed << std::setprecision(2)
+                << std::setw(12) << result.nsPerOp << std::setw(12) << result.minNsPerOp
+                << std::scientific << std::setw(14) << result.OpsPerSecond() << " " << result.unit;
+            if (const auto it = baseline.find(result.name); it != baseline.end() && result.nsPerOp > 0) {
+                out << std::fixed << "   x" << it->second / result.nsPerOp;
+            }
+            out << "\n";
+        }
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    // Un resultat par ligne pour que readBaseline puisse relire le fichier sans parseur JSON
+    void WriteJson(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& metadata) const {
+        out << "{\n  \"metadata\": {";
+        for (size_t i = 0; i < metadata.size(); ++i) {
+            out << (i == 0 ? "\n" : ",\n") << "    \"" << jsonEscape(metadata[i].first) << "\": \"" << jsonEscape(metadata[i].second) << "\"";
+        }
+        out << "\n  },\n  \"results\": [";
+        out << std::setprecision(9);
+        for (size_t i = 0; i < results.size(); ++i) {
+            const BenchmarkResult& r = results[i];
+            out << (i == 0 ? "\n" : ",\n")
+                << "    { \"name\": \"" << jsonEscape(r.name) << "\", \"unit\": \"" << jsonEscape(r.unit)
+                << "\", \"operations\": " << r.operations << ", \"ns_per_op\": " << r.nsPerOp
+                << ", \"min_ns_per_op\": " << r.minNsPerOp << ", \"ops_per_s\": " << r.OpsPerSecond()
+                << ", \"checksum\": " << r.checksum << " }";
+        }
+        out << "\n  ]\n}\n";
+    }
+};
+
+// Relit les ns_per_op d'un fichier ecrit par WriteJson, par nom de noyau
+inline std::map<std::string, double> readBaseline(const std::string& filename) {
+    std::map<std::string, double> baseline;
+    std::ifstream in(filename);
+    std::string line;
+    while (std::getline(in, line)) {
+        const auto namePos = line.find("\"name\": \"");
+        const auto timePos = line.find("\"ns_per_op\": ");
+        if (namePos == std::string::npos || timePos == std::string::npos) {
+            continue;
+        }
+        const auto nameBegin = namePos + 9;
+        const std::string name = line.substr(nameBegin, line.find('"', nameBegin) - nameBegin);
+        std::istringstream value(line.substr(timePos + 13));
+        double ns = 0;
+        if (value >> ns) {
+            baseline[name] = ns;
+        }
+    }
+    return baseline;
+}
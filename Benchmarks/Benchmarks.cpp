@@ -0,0 +1,113 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "Benchmark.h"
+#include "KernelBenchmarks.h"
+#include "RenderBenchmarks.h"
+
+namespace {
+	// "1,2,4" -> { 1, 2, 4 }
+	template <typename T>
+	std::vector<T> parseList(const std::string& text)
+	{
+		std::vector<T> values;
+		std::istringstream in(text);
+		std::string item;
+		while (std::getline(in, item, ',')) {
+			values.push_back(static_cast<T>(std::stoll(item)));
+		}
+		return values;
+	}
+
+	// "256x256,512x512"
+	std::vector<std::pair<size_t, size_t>> parseResolutions(const std::string& text)
+	{
+		std::vector<std::pair<size_t, size_t>> resolutions;
+		std::istringstream in(text);
+		std::string item;
+		while (std::getline(in, item, ',')) {
+			const auto separator = item.find('x');
+			const size_t width = std::stoull(item.substr(0, separator));
+			resolutions.emplace_back(width, separator == std::string::npos ? width : std::stoull(item.substr(separator + 1)));
+		}
+		return resolutions;
+	}
+}
+
+// Benchmarks [--json fichier] [--baseline fichier] [--filter texte] [--repetitions n] [--min-time secondes]
+// Les resultats sont ecrits dans benchmarks.json par defaut ; --baseline compare a un fichier
+// produit par un autre commit.
+//
+// Benchmarks --scenes [--resolutions 256x256,512x512] [--samples 1,4] [--threads 1,2,4] [--filter scene]
+// rend le corpus de scenes au lieu des noyaux, resultats dans scenes.json par defaut.
+//
+// Benchmarks --check-tonemap verifie la precision des noyaux de tonemapping contre la
+// reference, sans mesure ; code de sortie 1 si un noyau s'en ecarte de plus d'un niveau.
+int main(int argc, char** argv)
+{
+	BenchmarkOptions options;
+	RenderBenchmarkOptions renderOptions;
+	bool scenes = false;
+	std::string jsonPath;
+	std::string baselinePath;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--scenes") {
+			scenes = true;
+		} else if (arg == "--check-tonemap") {
+			return checkTonemapAccuracy(std::cout) ? 0 : 1;
+		} else if (arg == "--json" && hasValue) {
+			jsonPath = argv[++i];
+		} else if (arg == "--baseline" && hasValue) {
+			baselinePath = argv[++i];
+		} else if (arg == "--filter" && hasValue) {
+			options.filter = argv[++i];
+			renderOptions.filter = options.filter;
+		} else if (arg == "--repetitions" && hasValue) {
+			options.repetitions = std::atoi(argv[++i]);
+			renderOptions.repetitions = options.repetitions;
+		} else if (arg == "--min-time" && hasValue) {
+			options.minSeconds = std::atof(argv[++i]);
+		} else if (arg == "--resolutions" && hasValue) {
+			renderOptions.resolutions = parseResolutions(argv[++i]);
+		} else if (arg == "--samples" && hasValue) {
+			renderOptions.samples = parseList<int>(argv[++i]);
+		} else if (arg == "--threads" && hasValue) {
+			renderOptions.threads = parseList<unsigned>(argv[++i]);
+		} else {
+			std::cerr << "Option inconnue : " << arg << "\n";
+			return 1;
+		}
+	}
+	if (jsonPath.empty()) {
+		jsonPath = scenes ? "scenes.json" : "benchmarks.json";
+	}
+
+	std::ofstream json(jsonPath);
+	if (!json) {
+		std::cerr << "Impossible d'ecrire " << jsonPath << "\n";
+		return 1;
+	}
+	auto metadata = buildMetadata();
+
+	if (scenes) {
+		metadata.emplace_back("hardware_threads", std::to_string(std::thread::hardware_concurrency()));
+		const std::vector<RenderBenchmarkResult> results = runRenderBenchmarks(renderOptions);
+		printRenderResults(std::cout, results);
+		writeRenderJson(json, results, metadata);
+	} else {
+		BenchmarkRunner runner(options);
+		runKernelBenchmarks(runner);
+		runner.Print(std::cout, baselinePath.empty() ? std::map<std::string, double>{} : readBaseline(baselinePath));
+		metadata.emplace_back("seed", std::to_string(BENCHMARK_SEED));
+		runner.WriteJson(json, metadata);
+	}
+	std::cout << "Resultats ecrits dans " << jsonPath << "\n";
+	return 0;
+}
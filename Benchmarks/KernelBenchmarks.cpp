@@ -0,0 +1,215 @@
+#include <array>
+#include <ostream>
+#include <vector>
+
+#include "KernelBenchmarks.h"
+#include "ProceduralMeshes.h"
+#include "Scene.h"
+#include "Tonemap.h"
+
+namespace {
+	constexpr size_t RAY_COUNT = 4096;
+	constexpr size_t TONEMAP_PIXELS = 256 * 256;
+
+	Real uniform(const uint32_t index, const uint32_t stream, const uint32_t dimension)
+	{
+		static const CounterSampler sampler(BENCHMARK_SEED);
+		return sampler.Uniform<Real>(index, stream, dimension);
+	}
+
+	Vec3 pointInBox(const uint32_t index, const uint32_t stream, const Vec3& center, const Real extent)
+	{
+		return center + Vec3(
+			(uniform(index, stream, 0) * 2 - 1) * extent,
+			(uniform(index, stream, 1) * 2 - 1) * extent,
+			(uniform(index, stream, 2) * 2 - 1) * extent
+		);
+	}
+
+	// Rayons partant d'une sphere de rayon 20 autour de center, vises sur des points du cube
+	// [center - extent, center + extent] : une partie touche l'objet teste, le reste le rate
+	std::vector<Rayon> makeRays(const uint32_t stream, const Vec3& center, const Real extent)
+	{
+		std::vector<Rayon> rays;
+		rays.reserve(RAY_COUNT);
+		for (uint32_t i = 0; i < RAY_COUNT; ++i) {
+			const Vec3 origin = center + (pointInBox(i, stream, Vec3(0, 0, 0), 1).normalize() * 20);
+			const Vec3 target = pointInBox(i, stream + 1, center, extent);
+			rays.emplace_back(origin, (target - origin).normalize());
+		}
+		return rays;
+	}
+
+	template <typename Fn>
+	void runRayKernel(BenchmarkRunner& runner, const std::string& name, const std::vector<Rayon>& rays, Fn&& intersect)
+	{
+		runner.Run(name, "rays", rays.size(), [&] {
+			double sum = 0;
+			for (const Rayon& ray : rays) {
+				if (const std::optional<Real> t = intersect(ray)) {
+					sum += static_cast<double>(*t);
+				}
+			}
+			return sum;
+		});
+	}
+
+	// Grille de spheres dont une sur quatre en verre, une sphere maillee, un triangle isole,
+	// une boite de cinq plans et deux lumieres
+	Scene makeKernelScene()
+	{
+		Scene scene(Camera(Vec3(0, 0, -25), 500, 256, 256, 0, 200));
+
+		Material diffuseMaterial;
+		diffuseMaterial.color = Vec3(Real(0.8), Real(0.2), Real(0.2));
+		diffuseMaterial.specular = Real(0.1);
+		Material glassMaterial;
+		glassMaterial.color = Vec3(1, 1, 1);
+		glassMaterial.transparency = Real(0.9);
+		glassMaterial.refractiveIndex = Real(1.5);
+		const MaterialId diffuse = scene.AddMaterial(diffuseMaterial);
+		const MaterialId glass = scene.AddMaterial(glassMaterial);
+
+		for (int y = 0; y < 5; ++y) {
+			for (int x = 0; x < 5; ++x) {
+				Sphere sphere(Real(0.8), Vec3(-8 + x * 4, -8 + y * 4, 6), (x + y) % 4 == 0 ? glass : diffuse);
+				scene.AddSphere(sphere);
+			}
+		}
+
+		Model model(makeUvSphereMesh(64, 128), Transform{ Vec3(0, 0, 0), Vec3(0, 0, 0), Vec3(3, 3, 3) }, diffuse);
+		scene.AddModel(model);
+		Triangle triangle(Vec3(-6, 4, 2), Vec3(-2, 4, 2), Vec3(-4, 7, 2), diffuse);
+		scene.AddTriangle(triangle);
+
+		const std::array<Vec3, 5> normals = { Vec3(0, 0, -1), Vec3(1, 0, 0), Vec3(-1, 0, 0), Vec3(0, 1, 0), Vec3(0, -1, 0) };
+		for (const Vec3& normal : normals) {
+			Plane plane(normal * -15, normal, diffuse);
+			scene.AddPlane(plane);
+		}
+
+		Light first(Vec3(0, 0, -5), Vec3(1, 1, 1), 150);
+		Light second(Vec3(-2, 2, -5), Vec3(1, 1, 1), 150);
+		scene.AddLight(first);
+		scene.AddLight(second);
+
+		scene.BuildAccelerationStructure();
+		return scene;
+	}
+
+	void runShapeBenchmarks(BenchmarkRunner& runner)
+	{
+		const Sphere sphere(2, Vec3(0, 0, 0));
+		runRayKernel(runner, "sphere/intersect", makeRays(10, Vec3(0, 0, 0), 3), [&](const Rayon& ray) { return sphere.Intersect(ray); });
+
+		const Plane plane(Vec3(0, -2, 0), Vec3(0, 1, 0));
+		runRayKernel(runner, "plane/intersect", makeRays(20, Vec3(0, 0, 0), 3), [&](const Rayon& ray) { return plane.Intersect(ray); });
+
+		const Triangle triangle(Vec3(-3, -3, 0), Vec3(3, -3, 0), Vec3(0, 3, 0));
+		runRayKernel(runner, "triangle/intersect", makeRays(30, Vec3(0, 0, 0), 3), [&](const Rayon& ray) { return triangle.Intersect(ray); });
+
+		const Model model(makeUvSphereMesh(64, 128), Transform{ Vec3(0, 0, 0), Vec3(0, 0, 0), Vec3(2, 2, 2) });
+		runRayKernel(runner, "model/intersect", makeRays(40, Vec3(0, 0, 0), 3), [&](const Rayon& ray) { return model.Intersect(ray); });
+	}
+
+	void runSceneBenchmarks(BenchmarkRunner& runner)
+	{
+		const Scene scene = makeKernelScene();
+
+		runRayKernel(runner, "scene/intersect_closest", makeRays(50, Vec3(0, 0, 0), 10), [&](const Rayon& ray) -> std::optional<Real> {
+			if (const auto hit = scene.IntersectClosest(ray)) {
+				return hit->distance;
+			}
+			return std::nullopt;
+		});
+
+		// segments entre des points de la scene et la premiere lumiere
+		struct ShadowQuery {
+			Rayon ray;
+			Real distance;
+		};
+		std::vector<ShadowQuery> queries;
+		const Vec3 light(0, 0, -5);
+		for (uint32_t i = 0; i < RAY_COUNT; ++i) {
+			const Vec3 origin = pointInBox(i, 60, Vec3(0, 0, 0), 12);
+			const Vec3 toLight = light - origin;
+			queries.push_back({ Rayon(origin, toLight.normalize()), toLight.length() });
+		}
+		constexpr Real bias = Real(1e-3);
+		runner.Run("scene/transmittance", "rays", queries.size(), [&] {
+			double sum = 0;
+			for (const ShadowQuery& query : queries) {
+				sum += static_cast<double>(scene.computeTransmittance(query.ray, query.distance - bias, bias));
+			}
+			return sum;
+		});
+	}
+
+	void runCameraBenchmarks(BenchmarkRunner& runner)
+	{
+		Camera camera(Vec3(0, 0, -25), 500, 1000, 1000, 0, 200);
+		camera.maxSamples = 32;
+		const uint32_t sampleCount = static_cast<uint32_t>(camera.SampleCount());
+		runner.Run("camera/get_ray", "rays", RAY_COUNT, [&] {
+			double sum = 0;
+			for (uint32_t i = 0; i < RAY_COUNT; ++i) {
+				const Rayon ray = camera.getRay((i * 37) % camera.width, (i * 101) % camera.height, i % sampleCount, sampleCount);
+				sum += static_cast<double>(ray.direction.x);
+			}
+			return sum;
+		});
+	}
+
+	void runTonemapBenchmarks(BenchmarkRunner& runner)
+	{
+		// luminances etalees sur plusieurs ordres de grandeur, comme une image HDR
+		std::vector<Vec3> pixels(TONEMAP_PIXELS);
+		for (uint32_t i = 0; i < TONEMAP_PIXELS; ++i) {
+			const Real scale = std::exp2(uniform(i, 70, 3) * 12 - 6);
+			pixels[i] = Vec3(uniform(i, 70, 0), uniform(i, 70, 1), uniform(i, 70, 2)) * scale;
+		}
+		const std::span<const Vec3> referencePixels(pixels.data(), RAY_COUNT);
+
+		ThreadPool serialPool(1);
+		std::vector<Color> output(TONEMAP_PIXELS);
+		for (const TonemapOperator op : ALL_TONEMAP_OPERATORS) {
+			const std::string prefix = std::string("tonemap/") + tonemapName(op);
+			runner.Run(prefix + "/reference", "pixels", referencePixels.size(), [&] {
+				double sum = 0;
+				for (const Vec3& pixel : referencePixels) {
+					sum += tonemapPixel(op, pixel).g;
+				}
+				return sum;
+			});
+
+			const TonemapTarget target{ op, output };
+			for (const auto& [kernel, kernelName] : { std::pair{ TonemapKernel::SIMD, "/simd" }, std::pair{ TonemapKernel::CURVE, "/curve" } }) {
+				runner.Run(prefix + kernelName, "pixels", pixels.size(), [&] {
+					tonemap(pixels, { &target, 1 }, kernel, serialPool);
+					return static_cast<double>(output[TONEMAP_PIXELS / 2].g);
+				});
+			}
+		}
+	}
+}
+
+void runKernelBenchmarks(BenchmarkRunner& runner)
+{
+	runShapeBenchmarks(runner);
+	runSceneBenchmarks(runner);
+	runCameraBenchmarks(runner);
+	runTonemapBenchmarks(runner);
+}
+
+bool checkTonemapAccuracy(std::ostream& out)
+{
+	bool success = true;
+	for (const TonemapOperator op : ALL_TONEMAP_OPERATORS) {
+		for (const auto& [kernel, kernelName] : { std::pair{ TonemapKernel::SIMD, "simd" }, std::pair{ TonemapKernel::CURVE, "curve" } }) {
+			const int error = tonemapMaxLevelError(op, kernel);
+			out << "tonemap/" << tonemapName(op) << "/" << kernelName << " : " << error << " niveau(x)" << (error > 1 ? "  ECHEC" : "") << "\n";
+			success = success && error <= 1;
+		}
+	}
+	return success;
+}
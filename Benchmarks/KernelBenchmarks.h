@@ -0,0 +1,17 @@
+#pragma once
+
+#include <iosfwd>
+
+#include "Benchmark.h"
+
+// Les jeux de rayons et de pixels sont tires d'un CounterSampler a graine fixe :
+// memes entrees sur toutes les machines et a chaque commit
+inline constexpr uint32_t BENCHMARK_SEED = 0x5eed;
+
+// Intersections (Sphere, Plane, Triangle, Model, Scene), transmittance, Camera::getRay
+// et chaque operateur de tonemapping, sur un seul thread
+void runKernelBenchmarks(BenchmarkRunner& runner);
+
+// Compare les noyaux SIMD et CURVE de chaque operateur de tonemapping a la reference sur tout
+// l'intervalle des float ; false si un ecart depasse un niveau sur 255
+bool checkTonemapAccuracy(std::ostream& out);
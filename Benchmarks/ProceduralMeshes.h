@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <numbers>
+#include <vector>
+#include "Shape.h"
+
+// Sphere UV de rayon 1 centree a l'origine : rings * segments * 2 triangles, sans fichier a charger.
+// bumps deforme le rayon en relief irregulier, pour une BVH moins reguliere qu'une sphere lisse.
+inline std::shared_ptr<const Mesh> makeUvSphereMesh(const int rings, const int segments, const double bumps = 0.0) {
+    std::vector<Vec3> positions;
+    positions.reserve(static_cast<size_t>((rings + 1) * (segments + 1)));
+    for (int r = 0; r <= rings; ++r) {
+        const double theta = std::numbers::pi * r / rings;
+        for (int s = 0; s <= segments; ++s) {
+            const double phi = 2.0 * std::numbers::pi * s / segments;
+            const double radius = 1.0 + bumps * std::sin(7.0 * theta) * std::sin(9.0 * phi) * std::sin(3.0 * theta + 5.0 * phi);
+            positions.emplace_back(radius * std::sin(theta) * std::cos(phi), radius * std::cos(theta), radius * std::sin(theta) * std::sin(phi));
+        }
+    }
+
+    std::vector<int> indices;
+    indices.reserve(static_cast<size_t>(rings * segments * 6));
+    const int stride = segments + 1;
+    for (int r = 0; r < rings; ++r) {
+        for (int s = 0; s < segments; ++s) {
+            const int a = r * stride + s;
+            const int b = a + stride;
+            indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    return std::make_shared<const Mesh>(std::move(indices), std::move(positions));
+}
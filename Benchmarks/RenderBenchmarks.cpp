@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "RenderBenchmarks.h"
+#include "Benchmark.h"
+#include "SceneCorpus.h"
+#include "Stats.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+	// Remet a zero le pic de memoire residente quand le systeme le permet (Linux). Ailleurs le
+	// pic releve est celui du processus depuis son lancement.
+	void resetPeakRss()
+	{
+#if defined(__linux__)
+		std::ofstream clearRefs("/proc/self/clear_refs");
+		clearRefs << "5";
+#endif
+	}
+
+	size_t peakRssBytes()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+			return counters.PeakWorkingSetSize;
+		}
+		return 0;
+#elif defined(__linux__)
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line)) {
+			if (line.rfind("VmHWM:", 0) == 0) {
+				return static_cast<size_t>(std::stoull(line.substr(6))) * 1024;
+			}
+		}
+		return 0;
+#elif defined(__APPLE__)
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+		return static_cast<size_t>(usage.ru_maxrss);
+#else
+		return 0;
+#endif
+	}
+
+	std::vector<unsigned> defaultThreadCounts()
+	{
+		const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<unsigned> counts;
+		for (unsigned count = 1; count < cores; count *= 2) {
+			counts.push_back(count);
+		}
+		counts.push_back(cores);
+		return counts;
+	}
+
+	double median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values[values.size() / 2];
+	}
+
+	RenderBenchmarkResult runConfiguration(const CorpusScene& entry, const size_t width, const size_t height,
+		const int samples, const unsigned threads, const int repetitions)
+	{
+		using Clock = std::chrono::steady_clock;
+		ThreadPool::ConfigureGlobal(threads, false);
+
+		RenderBenchmarkResult result;
+		result.scene = entry.name;
+		result.width = width;
+		result.height = height;
+		result.samples = samples;
+		result.threads = threads;
+
+		std::vector<double> build, render, wall;
+		// remis a zero avant la creation des maillages, reconstruits a chaque repetition
+		resetPeakRss();
+		for (int r = 0; r < std::max(1, repetitions); ++r) {
+			// la construction de la scene compte : generation des maillages et leurs BVH, puis celle de la scene
+			const auto start = Clock::now();
+			Scene scene = entry.build(corpusCamera(width, height, samples));
+			scene.BuildAccelerationStructure();
+			const auto built = Clock::now();
+			Stats::Reset();
+			scene.RenderImage();
+			const auto end = Clock::now();
+
+			build.push_back(std::chrono::duration<double>(built - start).count());
+			render.push_back(std::chrono::duration<double>(end - built).count());
+			wall.push_back(std::chrono::duration<double>(end - start).count());
+			if constexpr (STATS_ENABLED) {
+				const RenderStats stats = Stats::Collect();
+				result.rays = 0;
+				for (const uint64_t rays : stats.rays) {
+					result.rays += rays;
+				}
+			}
+		}
+		result.peakRssBytes = peakRssBytes();
+		result.buildSeconds = median(build);
+		result.renderSeconds = median(render);
+		result.wallSeconds = median(wall);
+		return result;
+	}
+}
+
+std::vector<RenderBenchmarkResult> runRenderBenchmarks(const RenderBenchmarkOptions& options)
+{
+	const std::vector<unsigned> threadCounts = options.threads.empty() ? defaultThreadCounts() : options.threads;
+	std::vector<RenderBenchmarkResult> results;
+
+	for (const CorpusScene& entry : sceneCorpus()) {
+		if (!options.filter.empty() && entry.name.find(options.filter) == std::string::npos) {
+			continue;
+		}
+		for (const auto& [width, height] : options.resolutions) {
+			for (const int samples : options.samples) {
+				const size_t first = results.size();
+				for (const unsigned threads : threadCounts) {
+					std::cerr << "\r" << entry.name << " " << width << "x" << height << " " << samples << " spp " << threads << " threads   " << std::flush;
+					results.push_back(runConfiguration(entry, width, height, samples, threads, options.repetitions));
+				}
+
+				const auto reference = std::min_element(results.begin() + static_cast<std::ptrdiff_t>(first), results.end(),
+					[](const RenderBenchmarkResult& a, const RenderBenchmarkResult& b) { return a.threads < b.threads; });
+				for (size_t i = first; i < results.size(); ++i) {
+					RenderBenchmarkResult& result = results[i];
+					result.scalingEfficiency = result.wallSeconds > 0
+						? (reference->wallSeconds * reference->threads) / (result.wallSeconds * result.threads)
+						: 0.0;
+				}
+			}
+		}
+	}
+	std::cerr << "\n";
+
+	// le pool reprend sa taille par defaut
+	ThreadPool::ConfigureGlobal(0, false);
+	return results;
+}
+
+void printRenderResults(std::ostream& out, const std::vector<RenderBenchmarkResult>& results)
+{
+	const auto flags = out.flags();
+	const auto precision = out.precision();
+	out << std::left << std::setw(16) << "scene" << std::right << std::setw(11) << "resolution" << std::setw(6) << "spp"
+		<< std::setw(9) << "threads" << std::setw(11) << "total (s)" << std::setw(13) << "build (ms)" << std::setw(10) << "Mrays/s"
+		<< std::setw(10) << "RSS (Mo)" << std::setw(10) << "scaling" << "\n";
+	out << std::fixed;
+	for (const RenderBenchmarkResult& r : results) {
+		out << std::left << std::setw(16) << r.scene << std::right << std::setw(11) << (std::to_string(r.width) + "x" + std::to_string(r.height))
+			<< std::setw(6) << r.samples << std::setw(9) << r.threads
+			<< std::setprecision(3) << std::setw(11) << r.wallSeconds << std::setprecision(2) << std::setw(13) << r.buildSeconds * 1000;
+		if (r.rays > 0) {
+			out << std::setprecision(2) << std::setw(10) << r.MraysPerSecond();
+		} else {
+			out << std::setw(10) << "-";
+		}
+		out << std::setprecision(1) << std::setw(10) << static_cast<double>(r.peakRssBytes) / (1024.0 * 1024.0)
+			<< std::setprecision(2) << std::setw(10) << r.scalingEfficiency << "\n";
+	}
+	out.flags(flags);
+	out.precision(precision);
+}
+
+// Meme disposition que BenchmarkRunner::WriteJson : un resultat par ligne
+void writeRenderJson(std::ostream& out, const std::vector<RenderBenchmarkResult>& results,
+	const std::vector<std::pair<std::string, std::string>>& metadata)
+{
+	out << "{\n  \"metadata\": {";
+	for (size_t i = 0; i < metadata.size(); ++i) {
+		out << (i == 0 ? "\n" : ",\n") << "    \"" << jsonEscape(metadata[i].first) << "\": \"" << jsonEscape(metadata[i].second) << "\"";
+	}
+	out << "\n  },\n  \"renders\": [";
+	out << std::setprecision(9);
+	for (size_t i = 0; i < results.size(); ++i) {
+		const RenderBenchmarkResult& r = results[i];
+		out << (i == 0 ? "\n" : ",\n")
+			<< "    { \"scene\": \"" << jsonEscape(r.scene) << "\", \"width\": " << r.width << ", \"height\": " << r.height
+			<< ", \"samples\": " << r.samples << ", \"threads\": " << r.threads
+			<< ", \"wall_seconds\": " << r.wallSeconds << ", \"build_seconds\": " << r.buildSeconds << ", \"render_seconds\": " << r.renderSeconds
+			<< ", \"rays\": ";
+		if (r.rays > 0) {
+			out << r.rays << ", \"mrays_per_s\": " << r.MraysPerSecond();
+		} else {
+			out << "null, \"mrays_per_s\": null";
+		}
+		out << ", \"peak_rss_bytes\": " << r.peakRssBytes << ", \"scaling_efficiency\": " << r.scalingEfficiency << " }";
+	}
+	out << "\n  ]\n}\n";
+}
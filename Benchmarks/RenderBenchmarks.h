@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct RenderBenchmarkOptions {
+    std::vector<std::pair<size_t, size_t>> resolutions = { { 256, 256 }, { 512, 512 } };
+    std::vector<int> samples = { 1, 4 };
+    std::vector<unsigned> threads; // vide : 1, 2, 4... puis le nombre de coeurs
+    int repetitions = 3;
+    std::string filter;            // seules les scenes dont le nom contient filter sont rendues
+};
+
+// Une configuration (scene, resolution, echantillons, threads), temps medians sur les repetitions
+struct RenderBenchmarkResult {
+    std::string scene;
+    size_t width = 0;
+    size_t height = 0;
+    int samples = 0;
+    unsigned threads = 0;
+    double buildSeconds = 0;  // construction de la scene (maillages et leurs BVH) et BuildAccelerationStructure
+    double renderSeconds = 0; // RenderImage
+    double wallSeconds = 0;   // construction + rendu
+    uint64_t rays = 0;        // 0 sans RAYTRACING_STATS
+    size_t peakRssBytes = 0;
+    // temps de reference * ses threads / (temps * threads), la reference etant le plus petit
+    // nombre de threads mesure pour la meme scene, resolution et nombre d'echantillons
+    double scalingEfficiency = 0;
+
+    double MraysPerSecond() const { return renderSeconds > 0 ? static_cast<double>(rays) / renderSeconds * 1e-6 : 0.0; }
+};
+
+// Rend chaque scene du corpus pour toutes les combinaisons demandees, le pool global est
+// reconfigure pour chaque nombre de threads
+std::vector<RenderBenchmarkResult> runRenderBenchmarks(const RenderBenchmarkOptions& options);
+
+void printRenderResults(std::ostream& out, const std::vector<RenderBenchmarkResult>& results);
+void writeRenderJson(std::ostream& out, const std::vector<RenderBenchmarkResult>& results,
+    const std::vector<std::pair<std::string, std::string>>& metadata);
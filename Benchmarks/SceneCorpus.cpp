@@ -0,0 +1,156 @@
+#include <array>
+
+#include "SceneCorpus.h"
+#include "ProceduralMeshes.h"
+
+namespace {
+	Material diffuse(const Vec3& color, const Real specular = Real(0.05))
+	{
+		Material material;
+		material.color = color;
+		material.specular = specular;
+		material.shininess = 64;
+		return material;
+	}
+
+	Material glass()
+	{
+		Material material;
+		material.color = Vec3(1, 1, 1);
+		material.transparency = Real(0.95);
+		material.refractiveIndex = Real(1.5);
+		material.specular = Real(0.1);
+		return material;
+	}
+
+	void addPlane(Scene& scene, const Vec3& normal, const Real distance, const Material& material)
+	{
+		Plane plane(normal * -distance, normal, scene.AddMaterial(material));
+		scene.AddPlane(plane);
+	}
+
+	void addLight(Scene& scene, const Vec3& position, const Real intensity)
+	{
+		Light light(position, Vec3(1, 1, 1), intensity);
+		scene.AddLight(light);
+	}
+
+	// Boite de cinq plans ouverte vers la camera, comme dans main
+	void addBox(Scene& scene, const Material& left, const Material& right, const Material& walls)
+	{
+		addPlane(scene, Vec3(0, 0, -1), 15, walls);
+		addPlane(scene, Vec3(1, 0, 0), 15, left);
+		addPlane(scene, Vec3(-1, 0, 0), 15, right);
+		addPlane(scene, Vec3(0, 1, 0), 15, walls);
+		addPlane(scene, Vec3(0, -1, 0), 15, walls);
+	}
+
+	// 1000 spheres en grille 10 x 10 x 10, quelques miroirs et spheres de verre, un sol
+	Scene buildSpheres(const Camera& camera)
+	{
+		Scene scene(camera);
+		const MaterialId mirror = scene.AddMaterial(diffuse(Vec3(Real(0.1), Real(0.1), Real(0.1)), Real(0.8)));
+		const MaterialId clear = scene.AddMaterial(glass());
+		for (int z = 0; z < 10; ++z) {
+			for (int y = 0; y < 10; ++y) {
+				for (int x = 0; x < 10; ++x) {
+					const int index = (z * 10 + y) * 10 + x;
+					const MaterialId material = index % 11 == 0 ? clear
+						: index % 7 == 0 ? mirror
+						: scene.AddMaterial(diffuse(Vec3(Real(0.2) + Real(0.08) * x, Real(0.2) + Real(0.08) * y, Real(0.2) + Real(0.08) * z)));
+					Sphere sphere(Real(0.6), Vec3(-9 + x * 2, -9 + y * 2, z * 2), material);
+					scene.AddSphere(sphere);
+				}
+			}
+		}
+		addPlane(scene, Vec3(0, 1, 0), 12, diffuse(Vec3(Real(0.8), Real(0.8), Real(0.8))));
+		addLight(scene, Vec3(0, 0, -5), 150);
+		addLight(scene, Vec3(-2, 2, -5), 150);
+		return scene;
+	}
+
+	// Un million de triangles en relief ; le maillage et sa BVH sont reconstruits a chaque appel
+	// pour que leur cout et leur memoire comptent dans chaque configuration
+	Scene buildLargeMesh(const Camera& camera)
+	{
+		const std::shared_ptr<const Mesh> mesh = makeUvSphereMesh(500, 1000, 0.08);
+		Scene scene(camera);
+		Model model(mesh, Transform{ Vec3(0, 0, 5), Vec3(0, 0, 0), Vec3(8, 8, 8) }, scene.AddMaterial(diffuse(Vec3(Real(0.2), Real(0.4), Real(0.9)), Real(0.3))));
+		scene.AddModel(model);
+		addPlane(scene, Vec3(0, 1, 0), 12, diffuse(Vec3(Real(0.8), Real(0.8), Real(0.8))));
+		addLight(scene, Vec3(0, 0, -5), 150);
+		addLight(scene, Vec3(-2, 2, -5), 150);
+		return scene;
+	}
+
+	// Boite de Cornell remplie de verre : spheres empilees et une sphere maillee, les chemins
+	// se divisent a chaque interface jusqu'a maxRecursion
+	Scene buildCornellGlass(const Camera& camera)
+	{
+		Scene scene(camera);
+		const Material white = diffuse(Vec3(Real(0.8), Real(0.8), Real(0.8)));
+		addBox(scene, diffuse(Vec3(Real(0.8), Real(0.1), Real(0.1))), diffuse(Vec3(Real(0.1), Real(0.8), Real(0.1))), white);
+
+		const MaterialId clear = scene.AddMaterial(glass());
+		for (int row = 0; row < 3; ++row) {
+			for (int column = 0; column < 4; ++column) {
+				Sphere sphere(Real(2.2), Vec3(-7.5 + column * 5, -10 + row * 4.5, 2 + row * 2), clear);
+				scene.AddSphere(sphere);
+			}
+		}
+		Model model(makeUvSphereMesh(64, 128), Transform{ Vec3(0, 7, 8), Vec3(0, 0, 0), Vec3(4, 4, 4) }, clear);
+		scene.AddModel(model);
+		addLight(scene, Vec3(0, 12, 0), 200);
+		return scene;
+	}
+
+	// 64 lumieres : le cout est domine par les rayons d'ombre de l'eclairage direct
+	Scene buildManyLights(const Camera& camera)
+	{
+		Scene scene(camera);
+		for (int y = 0; y < 3; ++y) {
+			for (int x = 0; x < 3; ++x) {
+				Sphere sphere(Real(2), Vec3(-6 + x * 6, -6 + y * 6, 5), scene.AddMaterial(diffuse(Vec3(Real(0.3) + Real(0.3) * x, Real(0.5), Real(0.3) + Real(0.3) * y))));
+				scene.AddSphere(sphere);
+			}
+		}
+		addPlane(scene, Vec3(0, 0, -1), 15, diffuse(Vec3(Real(0.8), Real(0.8), Real(0.8))));
+		addPlane(scene, Vec3(0, 1, 0), 12, diffuse(Vec3(Real(0.8), Real(0.8), Real(0.8))));
+		for (int z = 0; z < 8; ++z) {
+			for (int x = 0; x < 8; ++x) {
+				addLight(scene, Vec3(-14 + x * 4, 10, -10 + z * 3), 10);
+			}
+		}
+		return scene;
+	}
+
+	// Seulement la boite de plans, testes lineairement hors BVH
+	Scene buildPlanesOnly(const Camera& camera)
+	{
+		Scene scene(camera);
+		const Material white = diffuse(Vec3(Real(0.8), Real(0.8), Real(0.8)));
+		addBox(scene, diffuse(Vec3(Real(0.8), Real(0.1), Real(0.1))), diffuse(Vec3(Real(0.1), Real(0.8), Real(0.1))), white);
+		addLight(scene, Vec3(0, 0, -5), 150);
+		return scene;
+	}
+}
+
+Camera corpusCamera(const size_t width, const size_t height, const int samples)
+{
+	Camera camera(Vec3(0, 0, -25), static_cast<Real>(width) / 2, width, height, 0, 200);
+	camera.minSamples = samples;
+	camera.maxSamples = samples;
+	return camera;
+}
+
+const std::vector<CorpusScene>& sceneCorpus()
+{
+	static const std::vector<CorpusScene> corpus = {
+		{ "spheres", "1000 spheres en grille, miroirs et verre", buildSpheres },
+		{ "large_mesh", "maillage d'un million de triangles", buildLargeMesh },
+		{ "cornell_glass", "boite de Cornell remplie de verre", buildCornellGlass },
+		{ "many_lights", "64 lumieres, domine par les rayons d'ombre", buildManyLights },
+		{ "planes_only", "cinq plans et une lumiere", buildPlanesOnly },
+	};
+	return corpus;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Scene.h"
+
+// Scene de reference du banc de rendu, construite pour une camera donnee (resolution, echantillons)
+struct CorpusScene {
+    std::string name;
+    std::string description;
+    Scene (*build)(const Camera& camera);
+};
+
+// Camera commune au corpus : meme position et meme champ de vision que main quelle que soit
+// la resolution, echantillonnage fixe (minSamples = maxSamples) pour un travail reproductible
+Camera corpusCamera(size_t width, size_t height, int samples);
+
+// spheres, large_mesh, cornell_glass, many_lights, planes_only
+const std::vector<CorpusScene>& sceneCorpus();
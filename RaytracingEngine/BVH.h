@@ -0,0 +1,473 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <atomic>
+#include <span>
+#include <utility>
+#include "Math.h"
+#include "ThreadPool.h"
+
+struct AABB {
+    static constexpr Real INF = std::numeric_limits<Real>::infinity();
+
+    Vec3 min{ INF, INF, INF };
+    Vec3 max{ -INF, -INF, -INF };
+
+    void expand(const Vec3& p) noexcept {
+        min = Vec3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+        max = Vec3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+    }
+
+    // an empty box (min = +inf, max = -inf) leaves this one unchanged instead of making it infinite
+    void expand(const AABB& o) noexcept {
+        if (!o.isValid()) {
+            return;
+        }
+        expand(o.min);
+        expand(o.max);
+    }
+
+    bool isValid() const noexcept { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+
+    Vec3 centroid() const noexcept { return (min + max) * 0.5; }
+
+    Real surfaceArea() const noexcept {
+        if (!isValid()) {
+            return 0.0;
+        }
+        const Vec3 e = max - min;
+        return Real(2) * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    // Slab test, invDir is 1 / ray.direction (infinite components are fine)
+    bool Intersect(const Rayon& ray, const Vec3& invDir, const Real tMax, Real& tNear) const noexcept {
+        const Real tx0 = (min.x - ray.origin.x) * invDir.x;
+        const Real tx1 = (max.x - ray.origin.x) * invDir.x;
+        Real tmin = std::min(tx0, tx1);
+        Real tmax = std::max(tx0, tx1);
+
+        const Real ty0 = (min.y - ray.origin.y) * invDir.y;
+        const Real ty1 = (max.y - ray.origin.y) * invDir.y;
+        tmin = std::max(tmin, std::min(ty0, ty1));
+        tmax = std::min(tmax, std::max(ty0, ty1));
+
+        const Real tz0 = (min.z - ray.origin.z) * invDir.z;
+        const Real tz1 = (max.z - ray.origin.z) * invDir.z;
+        tmin = std::max(tmin, std::min(tz0, tz1));
+        tmax = std::min(tmax, std::max(tz0, tz1));
+
+        tNear = tmin;
+        return tmax >= std::max(tmin, Real(0)) && tmin <= tMax;
+    }
+};
+
+// Conservative bounds of a packet of rays for interval culling (Boulos et al., "Packet-based
+// Whitted and Distribution Ray Tracing"): per axis interval of origins and inverse directions.
+// An axis on which the packet directions do not share a sign gives no constraint.
+struct RayInterval {
+    Real originMin[3], originMax[3];
+    Real invDirMin[3], invDirMax[3];
+    int sign[3]; // common sign of the directions, 0 when mixed
+
+    explicit RayInterval(const std::span<const Rayon> rays) noexcept {
+        for (int axis = 0; axis < 3; ++axis) {
+            originMin[axis] = invDirMin[axis] = AABB::INF;
+            originMax[axis] = invDirMax[axis] = -AABB::INF;
+            sign[axis] = 0;
+        }
+        bool first = true;
+        for (const Rayon& ray : rays) {
+            const Real origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+            const Real direction[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+            for (int axis = 0; axis < 3; ++axis) {
+                const int s = direction[axis] > 0 ? 1 : (direction[axis] < 0 ? -1 : 0);
+                sign[axis] = (first || sign[axis] == s) ? s : 0;
+                originMin[axis] = std::min(originMin[axis], origin[axis]);
+                originMax[axis] = std::max(originMax[axis], origin[axis]);
+                if (s != 0) {
+                    const Real inv = Real(1) / direction[axis];
+                    invDirMin[axis] = std::min(invDirMin[axis], inv);
+                    invDirMax[axis] = std::max(invDirMax[axis], inv);
+                }
+            }
+            first = false;
+        }
+    }
+
+    // False only if no ray of the packet can hit the box before tMax, tNear bounds the entry distances from below
+    bool Intersect(const AABB& box, const Real tMax, Real& tNear) const noexcept {
+        const Real boxMin[3] = { box.min.x, box.min.y, box.min.z };
+        const Real boxMax[3] = { box.max.x, box.max.y, box.max.z };
+        Real entry = 0;
+        Real exit = tMax;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (sign[axis] == 0) {
+                continue;
+            }
+            const Real nearPlane = sign[axis] > 0 ? boxMin[axis] : boxMax[axis];
+            const Real farPlane = sign[axis] > 0 ? boxMax[axis] : boxMin[axis];
+            entry = std::max(entry, Product(nearPlane - originMax[axis], nearPlane - originMin[axis], invDirMin[axis], invDirMax[axis]).first);
+            exit = std::min(exit, Product(farPlane - originMax[axis], farPlane - originMin[axis], invDirMin[axis], invDirMax[axis]).second);
+        }
+        tNear = entry;
+        return entry <= exit;
+    }
+
+private:
+    // [a0, a1] * [b0, b1] in interval arithmetic
+    static std::pair<Real, Real> Product(const Real a0, const Real a1, const Real b0, const Real b1) noexcept {
+        const Real p0 = a0 * b0, p1 = a0 * b1, p2 = a1 * b0, p3 = a1 * b1;
+        return { std::min(std::min(p0, p1), std::min(p2, p3)), std::max(std::max(p0, p1), std::max(p2, p3)) };
+    }
+};
+
+struct BVHNode {
+    AABB bounds;
+    uint32_t leftOrFirst = 0; // first child index for inner nodes, first primitive for leaves
+    uint32_t count = 0;       // primitive count, 0 for inner nodes
+
+    bool isLeaf() const noexcept { return count > 0; }
+};
+
+// Binned SAH bounding volume hierarchy over abstract primitives.
+// The BVH only knows primitive bounds, intersection is delegated to the caller
+// through the callbacks given to Traverse/TraverseAny.
+class BVH {
+private:
+    static constexpr int BIN_COUNT = 12;
+    static constexpr uint32_t MAX_LEAF_SIZE = 8;
+    static constexpr int MAX_DEPTH = 60;
+    static constexpr int STACK_SIZE = 64;
+    static constexpr uint32_t PARALLEL_BUILD_SIZE = 4096;
+
+    std::vector<BVHNode> nodes;
+    std::vector<uint32_t> primitiveIndices;
+
+    struct Bin {
+        AABB bounds;
+        uint32_t count = 0;
+    };
+
+    void UpdateBounds(const uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds) {
+        BVHNode& node = nodes[nodeIndex];
+        node.bounds = AABB{};
+        for (uint32_t i = 0; i < node.count; ++i) {
+            node.bounds.expand(primitiveBounds[primitiveIndices[node.leftOrFirst + i]]);
+        }
+    }
+
+    // Les sous-arbres d'au moins PARALLEL_BUILD_SIZE primitives sont construits par une tache du pool,
+    // les noeuds sont pre-alloues (2N - 1 au plus) et reserves par paire via nodeCount.
+    void Subdivide(const uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds, const std::vector<Vec3>& centroids, const int depth,
+        std::atomic<uint32_t>& nodeCount, TaskGroup& tasks) {
+        const uint32_t first = nodes[nodeIndex].leftOrFirst;
+        const uint32_t count = nodes[nodeIndex].count;
+        if (count <= 1 || depth >= MAX_DEPTH) {
+            return;
+        }
+
+        AABB centroidBounds;
+        for (uint32_t i = 0; i < count; ++i) {
+            centroidBounds.expand(centroids[primitiveIndices[first + i]]);
+        }
+
+        int bestAxis = -1;
+        int bestSplit = 0;
+        Real bestCost = std::numeric_limits<Real>::infinity();
+
+        for (int axis = 0; axis < 3; ++axis) {
+            const Real axisMin = centroidBounds.min.unsafeIndex(axis);
+            const Real axisMax = centroidBounds.max.unsafeIndex(axis);
+            if (axisMax - axisMin <= 1e-12) {
+                continue;
+            }
+
+            std::array<Bin, BIN_COUNT> bins{};
+            const Real scale = BIN_COUNT / (axisMax - axisMin);
+            for (uint32_t i = 0; i < count; ++i) {
+                const uint32_t primitive = primitiveIndices[first + i];
+                const int binIndex = std::min(BIN_COUNT - 1, static_cast<int>((centroids[primitive].unsafeIndex(axis) - axisMin) * scale));
+                bins[binIndex].count++;
+                bins[binIndex].bounds.expand(primitiveBounds[primitive]);
+            }
+
+            std::array<Real, BIN_COUNT - 1> leftArea{}, rightArea{};
+            std::array<uint32_t, BIN_COUNT - 1> leftCount{}, rightCount{};
+            AABB leftBox, rightBox;
+            uint32_t leftSum = 0, rightSum = 0;
+            for (int i = 0; i < BIN_COUNT - 1; ++i) {
+                leftSum += bins[i].count;
+                leftCount[i] = leftSum;
+                leftBox.expand(bins[i].bounds);
+                leftArea[i] = leftBox.surfaceArea();
+
+                rightSum += bins[BIN_COUNT - 1 - i].count;
+                rightCount[BIN_COUNT - 2 - i] = rightSum;
+                rightBox.expand(bins[BIN_COUNT - 1 - i].bounds);
+                rightArea[BIN_COUNT - 2 - i] = rightBox.surfaceArea();
+            }
+
+            for (int i = 0; i < BIN_COUNT - 1; ++i) {
+                if (leftCount[i] == 0 || rightCount[i] == 0) {
+                    continue;
+                }
+                const Real cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+
+        const Real leafCost = static_cast<Real>(count) * nodes[nodeIndex].bounds.surfaceArea();
+        if (bestAxis < 0 || (bestCost >= leafCost && count <= MAX_LEAF_SIZE)) {
+            return;
+        }
+
+        const Real axisMin = centroidBounds.min.unsafeIndex(bestAxis);
+        const Real scale = BIN_COUNT / (centroidBounds.max.unsafeIndex(bestAxis) - axisMin);
+        const auto middle = std::partition(primitiveIndices.begin() + first, primitiveIndices.begin() + first + count,
+            [&](const uint32_t primitive) {
+                const int binIndex = std::min(BIN_COUNT - 1, static_cast<int>((centroids[primitive].unsafeIndex(bestAxis) - axisMin) * scale));
+                return binIndex <= bestSplit;
+            });
+        const uint32_t leftCount = static_cast<uint32_t>(middle - primitiveIndices.begin()) - first;
+        if (leftCount == 0 || leftCount == count) {
+            return;
+        }
+
+        const uint32_t leftChild = nodeCount.fetch_add(2, std::memory_order_relaxed);
+        nodes[leftChild] = BVHNode{ AABB{}, first, leftCount };
+        nodes[leftChild + 1] = BVHNode{ AABB{}, first + leftCount, count - leftCount };
+        nodes[nodeIndex].leftOrFirst = leftChild;
+        nodes[nodeIndex].count = 0;
+
+        UpdateBounds(leftChild, primitiveBounds);
+        UpdateBounds(leftChild + 1, primitiveBounds);
+        if (leftCount >= PARALLEL_BUILD_SIZE) {
+            tasks.Run([this, leftChild, &primitiveBounds, &centroids, depth, &nodeCount, &tasks] {
+                Subdivide(leftChild, primitiveBounds, centroids, depth + 1, nodeCount, tasks);
+            });
+        } else {
+            Subdivide(leftChild, primitiveBounds, centroids, depth + 1, nodeCount, tasks);
+        }
+        Subdivide(leftChild + 1, primitiveBounds, centroids, depth + 1, nodeCount, tasks);
+    }
+
+    static Vec3 InverseDirection(const Vec3& direction) noexcept {
+        return Vec3(Real(1) / direction.x, Real(1) / direction.y, Real(1) / direction.z);
+    }
+
+public:
+    void Build(const std::vector<AABB>& primitiveBounds) {
+        nodes.clear();
+        primitiveIndices.resize(primitiveBounds.size());
+        std::iota(primitiveIndices.begin(), primitiveIndices.end(), 0u);
+        if (primitiveBounds.empty()) {
+            return;
+        }
+
+        std::vector<Vec3> centroids(primitiveBounds.size());
+        ThreadPool& pool = ThreadPool::Global();
+        pool.ParallelFor(0, primitiveBounds.size(), PARALLEL_BUILD_SIZE, [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                centroids[i] = primitiveBounds[i].centroid();
+            }
+        });
+
+        nodes.assign(primitiveBounds.size() * 2 - 1, BVHNode{});
+        nodes[0] = BVHNode{ AABB{}, 0, static_cast<uint32_t>(primitiveBounds.size()) };
+        UpdateBounds(0, primitiveBounds);
+
+        std::atomic<uint32_t> nodeCount{ 1 };
+        TaskGroup tasks(pool);
+        Subdivide(0, primitiveBounds, centroids, 0, nodeCount, tasks);
+        tasks.Wait();
+        nodes.resize(nodeCount.load());
+        nodes.shrink_to_fit();
+    }
+
+    bool IsEmpty() const noexcept { return nodes.empty(); }
+
+    AABB Bounds() const noexcept { return nodes.empty() ? AABB{} : nodes[0].bounds; }
+
+    // Primitive indices in leaf order, leaves reference contiguous ranges of it.
+    // Callers can lay their primitive data out in this order and use the leaf traversals.
+    const std::vector<uint32_t>& PrimitiveOrder() const noexcept { return primitiveIndices; }
+
+    // Closest-hit traversal over leaves: intersectLeaf(first, count, tMax) tests the range
+    // [first, first + count) of PrimitiveOrder(), returns true on a hit and shrinks tMax.
+    template <typename IntersectLeafFn>
+    bool TraverseLeaves(const Rayon& ray, Real& tMax, IntersectLeafFn&& intersectLeaf) const {
+        if (nodes.empty()) {
+            return false;
+        }
+
+        const Vec3 invDir = InverseDirection(ray.direction);
+        Real tNear;
+        if (!nodes[0].bounds.Intersect(ray, invDir, tMax, tNear)) {
+            return false;
+        }
+
+        std::array<std::pair<uint32_t, Real>, STACK_SIZE> stack;
+        int stackSize = 0;
+        uint32_t nodeIndex = 0;
+        bool hit = false;
+
+        while (true) {
+            const BVHNode& node = nodes[nodeIndex];
+            if (node.isLeaf()) {
+                if (intersectLeaf(node.leftOrFirst, node.count, tMax)) {
+                    hit = true;
+                }
+            } else {
+                Real tLeft, tRight;
+                const bool hitLeft = nodes[node.leftOrFirst].bounds.Intersect(ray, invDir, tMax, tLeft);
+                const bool hitRight = nodes[node.leftOrFirst + 1].bounds.Intersect(ray, invDir, tMax, tRight);
+                if (hitLeft && hitRight) {
+                    const bool leftFirst = tLeft <= tRight;
+                    stack[stackSize++] = leftFirst ? std::pair{ node.leftOrFirst + 1, tRight } : std::pair{ node.leftOrFirst, tLeft };
+                    nodeIndex = leftFirst ? node.leftOrFirst : node.leftOrFirst + 1;
+                    continue;
+                }
+                if (hitLeft || hitRight) {
+                    nodeIndex = hitLeft ? node.leftOrFirst : node.leftOrFirst + 1;
+                    continue;
+                }
+            }
+
+            // pop, skipping nodes that are now further than the closest hit
+            bool found = false;
+            while (stackSize > 0) {
+                const auto [candidate, tCandidate] = stack[--stackSize];
+                if (tCandidate <= tMax) {
+                    nodeIndex = candidate;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                return hit;
+            }
+        }
+    }
+
+    // Any-hit traversal over leaves: stops as soon as intersectLeaf(first, count) returns true.
+    template <typename IntersectLeafFn>
+    bool TraverseLeavesAny(const Rayon& ray, const Real tMax, IntersectLeafFn&& intersectLeaf) const {
+        if (nodes.empty()) {
+            return false;
+        }
+
+        const Vec3 invDir = InverseDirection(ray.direction);
+        std::array<uint32_t, STACK_SIZE> stack;
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            const BVHNode& node = nodes[stack[--stackSize]];
+            Real tNear;
+            if (!node.bounds.Intersect(ray, invDir, tMax, tNear)) {
+                continue;
+            }
+
+            if (node.isLeaf()) {
+                if (intersectLeaf(node.leftOrFirst, node.count)) {
+                    return true;
+                }
+            } else {
+                stack[stackSize++] = node.leftOrFirst + 1;
+                stack[stackSize++] = node.leftOrFirst;
+            }
+        }
+        return false;
+    }
+
+    // Closest-hit traversal: intersect(primitive, tMax) returns true on a hit and shrinks tMax.
+    template <typename IntersectFn>
+    bool Traverse(const Rayon& ray, Real& tMax, IntersectFn&& intersect) const {
+        return TraverseLeaves(ray, tMax, [&](const uint32_t first, const uint32_t count, Real& currentMax) {
+            bool hit = false;
+            for (uint32_t i = 0; i < count; ++i) {
+                if (intersect(primitiveIndices[first + i], currentMax)) {
+                    hit = true;
+                }
+            }
+            return hit;
+        });
+    }
+
+    // Any-hit traversal: stops as soon as intersect(primitive) returns true.
+    template <typename IntersectFn>
+    bool TraverseAny(const Rayon& ray, const Real tMax, IntersectFn&& intersect) const {
+        return TraverseLeavesAny(ray, tMax, [&](const uint32_t first, const uint32_t count) {
+            for (uint32_t i = 0; i < count; ++i) {
+                if (intersect(primitiveIndices[first + i])) {
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    // Packet traversal: a node is opened once for the whole packet if the interval test
+    // cannot rule it out. intersect(primitive, tMax) tests the rays of the packet and
+    // sets tMax to the furthest current hit distance among them.
+    template <typename IntersectFn>
+    void TraversePacket(const RayInterval& packet, Real& tMax, IntersectFn&& intersect) const {
+        if (nodes.empty()) {
+            return;
+        }
+
+        Real tNear;
+        if (!packet.Intersect(nodes[0].bounds, tMax, tNear)) {
+            return;
+        }
+
+        std::array<std::pair<uint32_t, Real>, STACK_SIZE> stack;
+        int stackSize = 0;
+        uint32_t nodeIndex = 0;
+
+        while (true) {
+            const BVHNode& node = nodes[nodeIndex];
+            if (node.isLeaf()) {
+                for (uint32_t i = 0; i < node.count; ++i) {
+                    intersect(primitiveIndices[node.leftOrFirst + i], tMax);
+                }
+            } else {
+                Real tLeft, tRight;
+                const bool hitLeft = packet.Intersect(nodes[node.leftOrFirst].bounds, tMax, tLeft);
+                const bool hitRight = packet.Intersect(nodes[node.leftOrFirst + 1].bounds, tMax, tRight);
+                if (hitLeft && hitRight) {
+                    const bool leftFirst = tLeft <= tRight;
+                    stack[stackSize++] = leftFirst ? std::pair{ node.leftOrFirst + 1, tRight } : std::pair{ node.leftOrFirst, tLeft };
+                    nodeIndex = leftFirst ? node.leftOrFirst : node.leftOrFirst + 1;
+                    continue;
+                }
+                if (hitLeft || hitRight) {
+                    nodeIndex = hitLeft ? node.leftOrFirst : node.leftOrFirst + 1;
+                    continue;
+                }
+            }
+
+            bool found = false;
+            while (stackSize > 0) {
+                const auto [candidate, tCandidate] = stack[--stackSize];
+                if (tCandidate <= tMax) {
+                    nodeIndex = candidate;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                return;
+            }
+        }
+    }
+};
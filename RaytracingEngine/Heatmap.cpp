@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#include "Heatmap.h"
+#include "Image.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+namespace {
+	const std::array<Vec3, 7> HEATMAP_STOPS = {
+		Vec3(0, 0, 0),
+		Vec3(0, 0, 1),
+		Vec3(0, 1, 1),
+		Vec3(0, 1, 0),
+		Vec3(1, 1, 0),
+		Vec3(1, 0, 0),
+		Vec3(1, 1, 1),
+	};
+
+	float channelValue(const PixelCost& cost, const HeatmapChannel channel)
+	{
+		switch (channel) {
+			case HeatmapChannel::CYCLES: return cost.cycles;
+			case HeatmapChannel::RAYS: return cost.rays;
+			case HeatmapChannel::TESTS: return cost.tests;
+		}
+		return 0.0f;
+	}
+
+	Color rampColor(const float t)
+	{
+		const float scaled = std::clamp(t, 0.0f, 1.0f) * static_cast<float>(HEATMAP_STOPS.size() - 1);
+		const size_t index = std::min(static_cast<size_t>(scaled), HEATMAP_STOPS.size() - 2);
+		const Real f = static_cast<Real>(scaled - static_cast<float>(index));
+		const Vec3 c = HEATMAP_STOPS[index] * (Real(1) - f) + HEATMAP_STOPS[index + 1] * f;
+		return Color(
+			static_cast<uint8_t>(c.x * 255 + Real(0.5)),
+			static_cast<uint8_t>(c.y * 255 + Real(0.5)),
+			static_cast<uint8_t>(c.z * 255 + Real(0.5))
+		);
+	}
+}
+
+const char* heatmapChannelName(const HeatmapChannel channel)
+{
+	switch (channel) {
+		case HeatmapChannel::CYCLES: return "cycles";
+		case HeatmapChannel::RAYS: return "rays";
+		case HeatmapChannel::TESTS: return "tests";
+	}
+	return "unknown";
+}
+
+std::vector<Color> heatmapColors(std::span<const PixelCost> costs, const HeatmapChannel channel)
+{
+	std::vector<Color> colors(costs.size());
+	if (costs.empty()) {
+		return colors;
+	}
+
+	std::vector<float> values(costs.size());
+	std::transform(costs.begin(), costs.end(), values.begin(), [channel](const PixelCost& cost) { return channelValue(cost, channel); });
+	std::vector<float> sorted = values;
+	const auto percentile = sorted.begin() + static_cast<std::ptrdiff_t>((sorted.size() - 1) * 99 / 100);
+	std::nth_element(sorted.begin(), percentile, sorted.end());
+	const float scale = *percentile > 0.0f ? 1.0f / *percentile : 0.0f;
+
+	ThreadPool::Global().ParallelFor(0, values.size(), 16384, [&](const size_t begin, const size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			colors[i] = rampColor(values[i] * scale);
+		}
+	});
+	return colors;
+}
+
+void writeHeatmaps(const std::string& prefix, std::span<const PixelCost> costs, const size_t width, const size_t height)
+{
+	TRACE_SCOPE("writeHeatmaps", "output");
+	if (costs.size() < width * height) {
+		throw std::runtime_error("Cost buffer smaller than image");
+	}
+
+	for (const HeatmapChannel channel : ALL_HEATMAP_CHANNELS) {
+		writePNG(prefix + "_" + heatmapChannelName(channel) + ".png", heatmapColors(costs, channel), width, height);
+	}
+
+	std::vector<Vec3> raw(width * height);
+	std::transform(costs.begin(), costs.begin() + static_cast<std::ptrdiff_t>(raw.size()), raw.begin(), [](const PixelCost& cost) {
+		return Vec3(cost.cycles, cost.rays, cost.tests);
+	});
+	writeEXR(prefix + ".exr", raw, width, height);
+}
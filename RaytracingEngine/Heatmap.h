@@ -0,0 +1,29 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include "Math.h"
+#include "Stats.h"
+
+enum class HeatmapChannel {
+	CYCLES, // temps passe sur le pixel (cycles TSC ou nanosecondes)
+	RAYS,   // rayons lances, ombres comprises
+	TESTS,  // tests d'intersection avec les primitives
+};
+
+inline constexpr HeatmapChannel ALL_HEATMAP_CHANNELS[] = {
+	HeatmapChannel::CYCLES,
+	HeatmapChannel::RAYS,
+	HeatmapChannel::TESTS,
+};
+
+const char* heatmapChannelName(HeatmapChannel channel);
+
+// Fausses couleurs du noir (cout nul) au blanc en passant par bleu, cyan, vert, jaune et rouge.
+// L'echelle s'arrete au 99e centile pour qu'une poignee de pixels extremes ne l'ecrase pas.
+std::vector<Color> heatmapColors(std::span<const PixelCost> costs, HeatmapChannel channel);
+
+// Ecrit <prefix>_cycles.png, <prefix>_rays.png, <prefix>_tests.png et les valeurs brutes en float
+// dans <prefix>.exr (R = cycles, G = rayons, B = tests)
+void writeHeatmaps(const std::string& prefix, std::span<const PixelCost> costs, const size_t width, const size_t height);
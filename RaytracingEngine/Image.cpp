@@ -5,27 +5,688 @@
 #include <string>
 #include <iomanip>
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <cstdlib>
+#include <span>
+#include <cerrno>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <climits>
+#include <unistd.h>
+#endif
 
 #include "Math.h"
+#include "Image.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+namespace {
+	static_assert(sizeof(Color) == 3, "Color doit etre 3 octets contigus");
+
+	// Ecrit les tampons a la suite dans le fichier, sans copie intermediaire :
+	// un seul appel writev en POSIX, un write par tampon sinon
+	void writeFile(const std::string& filename, std::initializer_list<std::span<const uint8_t>> buffers)
+	{
+		TRACE_SCOPE("writeFile", "output");
+#if defined(__linux__) || defined(__APPLE__)
+		const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			throw std::runtime_error("Could not open file for writing");
+		}
+
+		std::vector<iovec> pending;
+		for (const auto& buffer : buffers) {
+			if (!buffer.empty()) {
+				pending.push_back({ const_cast<uint8_t*>(buffer.data()), buffer.size() });
+			}
+		}
+		// writev peut s'arreter en cours de route, on reprend ou il s'est arrete
+		size_t first = 0;
+		while (first < pending.size()) {
+			const ssize_t written = ::writev(fd, pending.data() + first, static_cast<int>(std::min<size_t>(pending.size() - first, IOV_MAX)));
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				::close(fd);
+				throw std::runtime_error("Error occurred while writing to file");
+			}
+			size_t remaining = static_cast<size_t>(written);
+			while (first < pending.size() && remaining >= pending[first].iov_len) {
+				remaining -= pending[first].iov_len;
+				++first;
+			}
+			if (remaining > 0) {
+				pending[first].iov_base = static_cast<uint8_t*>(pending[first].iov_base) + remaining;
+				pending[first].iov_len -= remaining;
+			}
+		}
+		if (::close(fd) != 0) {
+			throw std::runtime_error("Error occurred while writing to file");
+		}
+#else
+		std::ofstream ofs(filename, std::ios::out | std::ios::binary);
+		if (!ofs) {
+			throw std::runtime_error("Could not open file for writing");
+		}
+
+		for (const auto& buffer : buffers) {
+			ofs.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+		}
+		ofs.close();
+		if (!ofs) {
+			throw std::runtime_error("Error occurred while writing to file");
+		}
+#endif
+
+		std::cout << "Image written to " << filename << "\n";
+	}
+
+	void putU32BE(std::vector<uint8_t>& out, const uint32_t value)
+	{
+		out.push_back(static_cast<uint8_t>(value >> 24));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	void putU32LE(std::vector<uint8_t>& out, const uint32_t value)
+	{
+		out.push_back(static_cast<uint8_t>(value));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 24));
+	}
+
+	void putU64LE(std::vector<uint8_t>& out, const uint64_t value)
+	{
+		putU32LE(out, static_cast<uint32_t>(value));
+		putU32LE(out, static_cast<uint32_t>(value >> 32));
+	}
+
+	void putF32LE(std::vector<uint8_t>& out, const float value)
+	{
+		putU32LE(out, std::bit_cast<uint32_t>(value));
+	}
+
+	void putString(std::vector<uint8_t>& out, const std::string& text, const bool nullTerminated)
+	{
+		out.insert(out.end(), text.begin(), text.end());
+		if (nullTerminated) {
+			out.push_back(0);
+		}
+	}
+
+	// --- Sommes de controle ---
+
+	constexpr std::array<uint32_t, 256> makeCrcTable()
+	{
+		std::array<uint32_t, 256> table{};
+		for (uint32_t n = 0; n < 256; ++n) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k) {
+				c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		return table;
+	}
+
+	constexpr std::array<uint32_t, 256> CRC_TABLE = makeCrcTable();
+
+	uint32_t crc32(const uint8_t* data, const size_t size, uint32_t crc = 0)
+	{
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i) {
+			crc = CRC_TABLE[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	constexpr uint32_t ADLER_BASE = 65521;
+
+	uint32_t adler32(const uint8_t* data, size_t size)
+	{
+		uint32_t a = 1, b = 0;
+		while (size > 0) {
+			// 5552 octets au plus avant que b ne deborde sur 32 bits
+			const size_t block = std::min<size_t>(size, 5552);
+			for (size_t i = 0; i < block; ++i) {
+				a += data[i];
+				b += a;
+			}
+			a %= ADLER_BASE;
+			b %= ADLER_BASE;
+			data += block;
+			size -= block;
+		}
+		return (b << 16) | a;
+	}
+
+	// Adler-32 de la concatenation A + B a partir des sommes de A et B (adler32_combine de zlib)
+	uint32_t adler32Combine(const uint32_t adlerA, const uint32_t adlerB, const size_t sizeB)
+	{
+		const uint64_t rem = sizeB % ADLER_BASE;
+		uint64_t sum1 = adlerA & 0xffff;
+		uint64_t sum2 = (rem * sum1) % ADLER_BASE;
+		sum1 += (adlerB & 0xffff) + ADLER_BASE - 1;
+		sum2 += ((adlerA >> 16) & 0xffff) + ((adlerB >> 16) & 0xffff) + ADLER_BASE - rem;
+		sum1 %= ADLER_BASE;
+		sum2 %= ADLER_BASE;
+		return static_cast<uint32_t>(sum1 | (sum2 << 16));
+	}
+
+	// --- Deflate (RFC 1951) ---
+
+	class BitWriter {
+	private:
+		std::vector<uint8_t>& out;
+		uint64_t buffer = 0;
+		int count = 0;
+
+	public:
+		explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+		// bits poses du poids faible au poids fort
+		void Write(const uint32_t value, const int bitCount) {
+			buffer |= static_cast<uint64_t>(value) << count;
+			count += bitCount;
+			while (count >= 8) {
+				out.push_back(static_cast<uint8_t>(buffer));
+				buffer >>= 8;
+				count -= 8;
+			}
+		}
+
+		// les codes de Huffman s'ecrivent a partir du bit de poids fort
+		void WriteHuffman(const uint32_t code, const int bitCount) {
+			uint32_t reversed = 0;
+			for (int i = 0; i < bitCount; ++i) {
+				reversed |= ((code >> i) & 1) << (bitCount - 1 - i);
+			}
+			Write(reversed, bitCount);
+		}
+
+		void AlignToByte() {
+			if (count > 0) {
+				Write(0, 8 - count);
+			}
+		}
+	};
+
+	constexpr std::array<uint16_t, 29> LENGTH_BASE = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	constexpr std::array<uint8_t, 29> LENGTH_EXTRA = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	constexpr std::array<uint16_t, 30> DISTANCE_BASE = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	constexpr std::array<uint8_t, 30> DISTANCE_EXTRA = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	constexpr size_t WINDOW_SIZE = 32768;
+	constexpr size_t MIN_MATCH = 3;
+	constexpr size_t MAX_MATCH = 258;
+	constexpr int MAX_CHAIN = 32;
+	constexpr size_t MAX_INSERT_LENGTH = 16;
+	constexpr uint32_t HASH_BITS = 15;
+
+	struct HuffmanCode {
+		uint16_t bits; // deja inverse, pret pour BitWriter::Write
+		uint8_t length;
+	};
+
+	// Codes fixes des litteraux/longueurs (RFC 1951, 3.2.6)
+	constexpr std::array<HuffmanCode, 288> makeFixedLiteralCodes()
+	{
+		std::array<HuffmanCode, 288> codes{};
+		for (uint32_t symbol = 0; symbol < 288; ++symbol) {
+			uint32_t code = 0;
+			int length = 0;
+			if (symbol < 144) {
+				code = 0x30 + symbol;
+				length = 8;
+			} else if (symbol < 256) {
+				code = 0x190 + symbol - 144;
+				length = 9;
+			} else if (symbol < 280) {
+				code = symbol - 256;
+				length = 7;
+			} else {
+				code = 0xc0 + symbol - 280;
+				length = 8;
+			}
+			uint32_t reversed = 0;
+			for (int i = 0; i < length; ++i) {
+				reversed |= ((code >> i) & 1) << (length - 1 - i);
+			}
+			codes[symbol] = { static_cast<uint16_t>(reversed), static_cast<uint8_t>(length) };
+		}
+		return codes;
+	}
+
+	constexpr std::array<HuffmanCode, 288> FIXED_LITERAL_CODES = makeFixedLiteralCodes();
+
+	void writeFixedLiteral(BitWriter& bits, const uint32_t symbol)
+	{
+		bits.Write(FIXED_LITERAL_CODES[symbol].bits, FIXED_LITERAL_CODES[symbol].length);
+	}
+
+	void writeFixedMatch(BitWriter& bits, const size_t length, const size_t distance)
+	{
+		const size_t lengthCode = std::upper_bound(LENGTH_BASE.begin(), LENGTH_BASE.end(), length) - LENGTH_BASE.begin() - 1;
+		writeFixedLiteral(bits, static_cast<uint32_t>(257 + lengthCode));
+		bits.Write(static_cast<uint32_t>(length - LENGTH_BASE[lengthCode]), LENGTH_EXTRA[lengthCode]);
+
+		const size_t distanceCode = std::upper_bound(DISTANCE_BASE.begin(), DISTANCE_BASE.end(), distance) - DISTANCE_BASE.begin() - 1;
+		bits.WriteHuffman(static_cast<uint32_t>(distanceCode), 5);
+		bits.Write(static_cast<uint32_t>(distance - DISTANCE_BASE[distanceCode]), DISTANCE_EXTRA[distanceCode]);
+	}
+
+	uint32_t hash3(const uint8_t* p)
+	{
+		const uint32_t v = static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16);
+		return (v * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	// Un bloc a codes fixes non final, LZ77 glouton sur chaine de hachage
+	void deflateFixedBlock(const uint8_t* data, const size_t size, BitWriter& bits)
+	{
+		bits.Write(0, 1); // BFINAL
+		bits.Write(1, 2); // BTYPE = 01, Huffman fixe
+
+		std::vector<int32_t> head(size_t(1) << HASH_BITS, -1);
+		std::vector<int32_t> prev(size, -1);
+		auto insert = [&](const size_t pos) {
+			if (pos + MIN_MATCH <= size) {
+				const uint32_t h = hash3(data + pos);
+				prev[pos] = head[h];
+				head[h] = static_cast<int32_t>(pos);
+			}
+		};
+
+		size_t pos = 0;
+		while (pos < size) {
+			size_t bestLength = 0;
+			size_t bestDistance = 0;
+			if (pos + MIN_MATCH <= size) {
+				const size_t maxLength = std::min(MAX_MATCH, size - pos);
+				int32_t candidate = head[hash3(data + pos)];
+				for (int chain = 0; candidate >= 0 && chain < MAX_CHAIN; ++chain, candidate = prev[candidate]) {
+					const size_t distance = pos - static_cast<size_t>(candidate);
+					if (distance > WINDOW_SIZE) {
+						break;
+					}
+					const uint8_t* a = data + candidate;
+					const uint8_t* b = data + pos;
+					if (a[bestLength] != b[bestLength]) {
+						continue;
+					}
+					size_t length = 0;
+					// compare 8 octets a la fois, puis finit octet par octet
+					while (length + 8 <= maxLength) {
+						uint64_t wordA, wordB;
+						std::memcpy(&wordA, a + length, 8);
+						std::memcpy(&wordB, b + length, 8);
+						if (wordA != wordB) {
+							break;
+						}
+						length += 8;
+					}
+					while (length < maxLength && a[length] == b[length]) {
+						++length;
+					}
+					if (length > bestLength) {
+						bestLength = length;
+						bestDistance = distance;
+						if (length == maxLength) {
+							break;
+						}
+					}
+				}
+			}
+
+			if (bestLength >= MIN_MATCH) {
+				writeFixedMatch(bits, bestLength, bestDistance);
+				// dans une longue correspondance, seules les premieres positions entrent dans la table
+				const size_t inserted = bestLength <= MAX_INSERT_LENGTH ? bestLength : 1;
+				for (size_t i = 0; i < inserted; ++i) {
+					insert(pos + i);
+				}
+				pos += bestLength;
+			} else {
+				writeFixedLiteral(bits, data[pos]);
+				insert(pos);
+				++pos;
+			}
+		}
+
+		writeFixedLiteral(bits, 256); // fin de bloc
+	}
 
-void writePPM(const std::string& filename, const std::vector<Color>& pixels, const size_t width, const size_t height)
+	// Blocs non compresses non finaux, 65535 octets au plus chacun
+	void deflateStoredBlocks(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+	{
+		while (size > 0) {
+			const uint16_t length = static_cast<uint16_t>(std::min<size_t>(size, 65535));
+			out.push_back(0); // BFINAL = 0, BTYPE = 00, aligne
+			out.push_back(static_cast<uint8_t>(length));
+			out.push_back(static_cast<uint8_t>(length >> 8));
+			out.push_back(static_cast<uint8_t>(~length));
+			out.push_back(static_cast<uint8_t>(~length >> 8));
+			out.insert(out.end(), data, data + length);
+			data += length;
+			size -= length;
+		}
+	}
+
+	// Flux deflate d'une tranche, termine sur une frontiere d'octet par un bloc stocke vide
+	// (sync flush) : les tranches se concatenent telles quelles
+	std::vector<uint8_t> deflateChunk(const uint8_t* data, const size_t size, const PngCompression compression)
+	{
+		std::vector<uint8_t> out;
+		if (compression == PngCompression::STORED) {
+			out.reserve(size + size / 65535 * 5 + 5);
+			deflateStoredBlocks(data, size, out);
+			return out;
+		}
+
+		out.reserve(size / 2 + 16);
+		BitWriter bits(out);
+		deflateFixedBlock(data, size, bits);
+		bits.Write(0, 3);
+		bits.AlignToByte();
+		out.insert(out.end(), { 0x00, 0x00, 0xff, 0xff });
+		return out;
+	}
+
+	// Flux zlib (RFC 1950) complet
+	std::vector<uint8_t> zlibCompress(const std::vector<uint8_t>& data, const PngOptions& options)
+	{
+		const size_t chunkSize = options.parallel ? std::max<size_t>(options.chunkSize, WINDOW_SIZE) : std::max<size_t>(data.size(), 1);
+		const size_t chunkCount = std::max<size_t>(1, (data.size() + chunkSize - 1) / chunkSize);
+
+		std::vector<std::vector<uint8_t>> compressed(chunkCount);
+		std::vector<uint32_t> adlers(chunkCount);
+		auto compressChunk = [&](const size_t first, const size_t last) {
+			for (size_t i = first; i < last; ++i) {
+				const size_t begin = i * chunkSize;
+				const size_t size = std::min(chunkSize, data.size() - begin);
+				compressed[i] = deflateChunk(data.data() + begin, size, options.compression);
+				adlers[i] = adler32(data.data() + begin, size);
+			}
+		};
+		if (chunkCount > 1) {
+			ThreadPool::Global().ParallelFor(0, chunkCount, 1, compressChunk);
+		} else {
+			compressChunk(0, chunkCount);
+		}
+
+		std::vector<uint8_t> out = { 0x78, 0x01 }; // deflate, fenetre 32 Ko, niveau le plus rapide
+		size_t total = out.size() + 9;
+		for (const auto& chunk : compressed) {
+			total += chunk.size();
+		}
+		out.reserve(total);
+
+		uint32_t adler = 1;
+		for (size_t i = 0; i < chunkCount; ++i) {
+			out.insert(out.end(), compressed[i].begin(), compressed[i].end());
+			const size_t size = std::min(chunkSize, data.size() - i * chunkSize);
+			adler = i == 0 ? adlers[i] : adler32Combine(adler, adlers[i], size);
+		}
+		out.insert(out.end(), { 0x01, 0x00, 0x00, 0xff, 0xff }); // bloc stocke vide final
+		putU32BE(out, adler);
+		return out;
+	}
+
+	// --- PNG ---
+
+	uint8_t paeth(const int a, const int b, const int c)
+	{
+		const int p = a + b - c;
+		const int pa = std::abs(p - a);
+		const int pb = std::abs(p - b);
+		const int pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc) {
+			return static_cast<uint8_t>(a);
+		}
+		return static_cast<uint8_t>(pb <= pc ? b : c);
+	}
+
+	constexpr size_t PNG_BPP = 3; // octets par pixel, RGB 8 bits
+
+	template <int FILTER>
+	uint8_t filterByte(const uint8_t* row, const uint8_t* above, const size_t i, const bool first)
+	{
+		const int a = first ? 0 : row[i - PNG_BPP];
+		const int b = above[i];
+		const int c = first ? 0 : above[i - PNG_BPP];
+		int predictor = 0;
+		if constexpr (FILTER == 1) {
+			predictor = a;
+		} else if constexpr (FILTER == 2) {
+			predictor = b;
+		} else if constexpr (FILTER == 3) {
+			predictor = (a + b) / 2;
+		} else if constexpr (FILTER == 4) {
+			predictor = paeth(a, b, c);
+		}
+		return static_cast<uint8_t>(row[i] - predictor);
+	}
+
+	// Applique le filtre a la ligne (out peut etre nul) et renvoie la somme des residus en valeur absolue
+	template <int FILTER>
+	uint64_t applyFilter(const uint8_t* row, const uint8_t* above, const size_t rowBytes, uint8_t* out)
+	{
+		uint64_t score = 0;
+		const size_t head = std::min(PNG_BPP, rowBytes);
+		for (size_t i = 0; i < head; ++i) {
+			const uint8_t value = filterByte<FILTER>(row, above, i, true);
+			score += static_cast<uint64_t>(std::abs(static_cast<int8_t>(value)));
+			if (out) {
+				out[i] = value;
+			}
+		}
+		for (size_t i = head; i < rowBytes; ++i) {
+			const uint8_t value = filterByte<FILTER>(row, above, i, false);
+			score += static_cast<uint64_t>(std::abs(static_cast<int8_t>(value)));
+			if (out) {
+				out[i] = value;
+			}
+		}
+		return score;
+	}
+
+	// Filtre une ligne avec les 5 filtres PNG et garde celui de plus petite somme absolue.
+	// above pointe sur la ligne precedente, ou sur des zeros pour la premiere.
+	void filterRow(const uint8_t* row, const uint8_t* above, const size_t rowBytes, uint8_t* out)
+	{
+		using FilterFn = uint64_t(*)(const uint8_t*, const uint8_t*, size_t, uint8_t*);
+		constexpr FilterFn FILTERS[5] = { applyFilter<0>, applyFilter<1>, applyFilter<2>, applyFilter<3>, applyFilter<4> };
+
+		size_t bestFilter = 0;
+		uint64_t bestScore = UINT64_MAX;
+		for (size_t filter = 0; filter < 5; ++filter) {
+			const uint64_t score = FILTERS[filter](row, above, rowBytes, nullptr);
+			if (score < bestScore) {
+				bestScore = score;
+				bestFilter = filter;
+			}
+		}
+
+		out[0] = static_cast<uint8_t>(bestFilter);
+		FILTERS[bestFilter](row, above, rowBytes, out + 1);
+	}
+
+	void putPngChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+	{
+		putU32BE(out, static_cast<uint32_t>(data.size()));
+		const size_t typeOffset = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data.begin(), data.end());
+		putU32BE(out, crc32(out.data() + typeOffset, data.size() + 4));
+	}
+}
+
+void writePPM(const std::string& filename, std::span<const Color> pixels, const size_t width, const size_t height)
+{
+	TRACE_SCOPE("writePPM", "output");
+	if (pixels.size() < width * height) {
+		throw std::runtime_error("Pixel buffer smaller than image");
+	}
+
+	// Color est deja du RGB 8 bits contigu : l'en-tete puis le buffer tel quel
+	const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+	writeFile(filename, {
+		std::span(reinterpret_cast<const uint8_t*>(header.data()), header.size()),
+		std::span(reinterpret_cast<const uint8_t*>(pixels.data()), width * height * sizeof(Color)) });
+}
+
+std::vector<uint8_t> encodePNG(std::span<const Color> pixels, const size_t width, const size_t height, const PngOptions& options)
+{
+	TRACE_SCOPE("encodePNG", "output");
+	if (pixels.size() < width * height) {
+		throw std::runtime_error("Pixel buffer smaller than image");
+	}
+
+	// lignes filtrees : un octet de filtre puis les octets RGB
+	const size_t rowBytes = width * 3;
+	const uint8_t* raw = reinterpret_cast<const uint8_t*>(pixels.data());
+	const std::vector<uint8_t> zeroRow(rowBytes, 0);
+	std::vector<uint8_t> filtered(height * (rowBytes + 1));
+	auto filterRows = [&](const size_t first, const size_t last) {
+		for (size_t y = first; y < last; ++y) {
+			uint8_t* out = filtered.data() + y * (rowBytes + 1);
+			if (options.compression == PngCompression::STORED) {
+				// rien a gagner a filtrer sans compression
+				out[0] = 0;
+				std::memcpy(out + 1, raw + y * rowBytes, rowBytes);
+			} else {
+				filterRow(raw + y * rowBytes, y > 0 ? raw + (y - 1) * rowBytes : zeroRow.data(), rowBytes, out);
+			}
+		}
+	};
+	if (options.parallel) {
+		ThreadPool::Global().ParallelFor(0, height, 16, filterRows);
+	} else {
+		filterRows(0, height);
+	}
+
+	std::vector<uint8_t> header;
+	putU32BE(header, static_cast<uint32_t>(width));
+	putU32BE(header, static_cast<uint32_t>(height));
+	header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bits, RGB, deflate, filtrage adaptatif, non entrelace
+
+	const std::vector<uint8_t> idat = zlibCompress(filtered, options);
+
+	std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	png.reserve(idat.size() + 64);
+	putPngChunk(png, "IHDR", header);
+	putPngChunk(png, "IDAT", idat);
+	putPngChunk(png, "IEND", {});
+	return png;
+}
+
+void writePNG(const std::string& filename, std::span<const Color> pixels, const size_t width, const size_t height, const PngOptions& options)
 {
-	std::ofstream ofs(filename, std::ios::out | std::ios::binary);
-	if (!ofs) {
-		throw std::runtime_error("Could not open file for writing");
+	TRACE_SCOPE("writePNG", "output");
+	const std::vector<uint8_t> png = encodePNG(pixels, width, height, options);
+	writeFile(filename, { png });
+}
+
+void writePFM(const std::string& filename, std::span<const Vec3> pixels, const size_t width, const size_t height)
+{
+	TRACE_SCOPE("writePFM", "output");
+	if (pixels.size() < width * height) {
+		throw std::runtime_error("Pixel buffer smaller than image");
 	}
 
-	ofs << "P6\n" << width << " " << height << "\n255\n";
-	for (const auto& pixel : pixels) {
-		ofs << static_cast<char>(std::min(255, std::max(0, static_cast<int>(pixel.r))))
-			<< static_cast<char>(std::min(255, std::max(0, static_cast<int>(pixel.g))))
-			<< static_cast<char>(std::min(255, std::max(0, static_cast<int>(pixel.b))));
+	std::vector<uint8_t> bytes;
+	// echelle negative : floats little endian
+	putString(bytes, "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n", false);
+	bytes.reserve(bytes.size() + width * height * 12);
+	// PFM stocke les lignes de bas en haut
+	for (size_t y = height; y-- > 0;) {
+		for (size_t x = 0; x < width; ++x) {
+			const Vec3& pixel = pixels[y * width + x];
+			putF32LE(bytes, static_cast<float>(pixel.x));
+			putF32LE(bytes, static_cast<float>(pixel.y));
+			putF32LE(bytes, static_cast<float>(pixel.z));
+		}
 	}
+	writeFile(filename, { bytes });
+}
 
-	ofs.close();
-	if (!ofs) {
-		throw std::runtime_error("Error occurred while writing to file");
+void writeEXR(const std::string& filename, std::span<const Vec3> pixels, const size_t width, const size_t height)
+{
+	TRACE_SCOPE("writeEXR", "output");
+	if (pixels.size() < width * height) {
+		throw std::runtime_error("Pixel buffer smaller than image");
 	}
 
-	std::cout << "Image written to " << filename << "\n";
+	std::vector<uint8_t> bytes;
+	putU32LE(bytes, 20000630); // magic
+	putU32LE(bytes, 2);        // version 2, scanlines simples
+
+	auto attribute = [&bytes](const std::string& name, const std::string& type, const uint32_t size) {
+		putString(bytes, name, true);
+		putString(bytes, type, true);
+		putU32LE(bytes, size);
+	};
+
+	// canaux tries par nom, en FLOAT 32 bits
+	const char channelNames[3] = { 'B', 'G', 'R' };
+	attribute("channels", "chlist", 3 * 18 + 1);
+	for (const char name : channelNames) {
+		bytes.push_back(static_cast<uint8_t>(name));
+		bytes.push_back(0);
+		putU32LE(bytes, 2); // FLOAT
+		bytes.insert(bytes.end(), { 0, 0, 0, 0 }); // pLinear + reserve
+		putU32LE(bytes, 1); // xSampling
+		putU32LE(bytes, 1); // ySampling
+	}
+	bytes.push_back(0);
+
+	attribute("compression", "compression", 1);
+	bytes.push_back(0); // NO_COMPRESSION
+	for (const char* window : { "dataWindow", "displayWindow" }) {
+		attribute(window, "box2i", 16);
+		putU32LE(bytes, 0);
+		putU32LE(bytes, 0);
+		putU32LE(bytes, static_cast<uint32_t>(width - 1));
+		putU32LE(bytes, static_cast<uint32_t>(height - 1));
+	}
+	attribute("lineOrder", "lineOrder", 1);
+	bytes.push_back(0); // INCREASING_Y
+	attribute("pixelAspectRatio", "float", 4);
+	putF32LE(bytes, 1.0f);
+	attribute("screenWindowCenter", "v2f", 8);
+	putF32LE(bytes, 0.0f);
+	putF32LE(bytes, 0.0f);
+	attribute("screenWindowWidth", "float", 4);
+	putF32LE(bytes, 1.0f);
+	bytes.push_back(0); // fin de l'en-tete
+
+	// table des offsets, un bloc par ligne : y, taille, puis chaque canal sur toute la ligne
+	const size_t lineBytes = width * 3 * sizeof(float);
+	const size_t firstLine = bytes.size() + height * sizeof(uint64_t);
+	for (size_t y = 0; y < height; ++y) {
+		putU64LE(bytes, firstLine + y * (8 + lineBytes));
+	}
+	bytes.reserve(firstLine + height * (8 + lineBytes));
+	for (size_t y = 0; y < height; ++y) {
+		putU32LE(bytes, static_cast<uint32_t>(y));
+		putU32LE(bytes, static_cast<uint32_t>(lineBytes));
+		const Vec3* row = pixels.data() + y * width;
+		for (const Real Vec3::* channel : { &Vec3::z, &Vec3::y, &Vec3::x }) {
+			for (size_t x = 0; x < width; ++x) {
+				putF32LE(bytes, static_cast<float>(row[x].*channel));
+			}
+		}
+	}
+	writeFile(filename, { bytes });
 }
@@ -2,6 +2,30 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
+#include <span>
 #include "Math.h"
 
-void writePPM(const std::string& filename, const std::vector<Color>& pixels, const size_t width, const size_t height);
\ No newline at end of file
+enum class PngCompression {
+	STORED,        // blocs deflate non compresses, le plus rapide
+	FIXED_HUFFMAN, // LZ77 + codes de Huffman fixes, sans table a transmettre
+};
+
+struct PngOptions {
+	PngCompression compression = PngCompression::FIXED_HUFFMAN;
+	// Compresse des tranches independantes sur le pool (comme pigz), chaque tranche
+	// repart d'un dictionnaire vide : legerement moins compact qu'un flux serie
+	bool parallel = true;
+	size_t chunkSize = 256 * 1024; // octets de lignes filtrees par tranche
+};
+
+// Pixels deja en RGB 8 bits : ecrits tels quels derriere l'en-tete, sans conversion ni copie
+void writePPM(const std::string& filename, std::span<const Color> pixels, const size_t width, const size_t height);
+
+// PNG RGB 8 bits, encodeur integre sans zlib
+std::vector<uint8_t> encodePNG(std::span<const Color> pixels, const size_t width, const size_t height, const PngOptions& options = {});
+void writePNG(const std::string& filename, std::span<const Color> pixels, const size_t width, const size_t height, const PngOptions& options = {});
+
+// Buffer HDR avant tonemapping, en float 32 bits
+void writePFM(const std::string& filename, std::span<const Vec3> pixels, const size_t width, const size_t height);
+void writeEXR(const std::string& filename, std::span<const Vec3> pixels, const size_t width, const size_t height); // scanlines non compressees
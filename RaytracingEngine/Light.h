@@ -6,8 +6,8 @@
 struct Light {
 	Vec3 position;
 	Vec3 color;
-	double intensity;
-	Light(const Vec3& position, const Vec3& color, const double& intensity)
+	Real intensity;
+	Light(const Vec3& position, const Vec3& color, const Real& intensity)
 		: position(position), color(color), intensity(intensity) {
 	}
 
@@ -18,26 +18,26 @@ struct Light {
 		return position - point;
 	}
 
-	double distanceTo(const Vec3& point) const {
+	Real distanceTo(const Vec3& point) const {
 		return toLightDirection(point).length();
 	}
 
 	Vec3 dirTo(const Vec3& point) const {
-		static constexpr double EPS = 1e-12;
+		static constexpr Real EPS = Real(1e-12);
 		const Vec3 v = position - point;
 
-		const double nonSquaredLen = v.x * v.x + v.y * v.y + v.z * v.z;
-		const double esp2 = EPS * EPS;
+		const Real nonSquaredLen = v.x * v.x + v.y * v.y + v.z * v.z;
+		const Real esp2 = EPS * EPS;
 		if (nonSquaredLen <= esp2)
 		{
 			return Vec3{ 0, 0, 0 };
 		}
 
-		const double invLen = 1.0 / std::sqrt(nonSquaredLen);
+		const Real invLen = Real(1) / std::sqrt(nonSquaredLen);
 		return invLen * v;
 	}
 
-	Rayon shadowRayFrom(const Vec3& hitPoint, const double bias) const {
+	Rayon shadowRayFrom(const Vec3& hitPoint, const Real bias) const {
 		const Vec3 Ldir = dirTo(hitPoint);
 		return Rayon{
 			hitPoint + Ldir * bias,
@@ -49,12 +49,12 @@ struct Light {
 		return color * intensity;
 	}
 
-	Vec3 contributionFrom(const double dist, const double NdotL) const {
-		const double EPS = 1e-12;
+	Vec3 contributionFrom(const Real dist, const Real NdotL) const {
+		const Real EPS = Real(1e-12);
 		if (dist <= EPS || NdotL <= 0.0) {
 			return Vec3{ 0, 0, 0 };
 		}
-		return emitted() * (1.0 / (dist * dist) * NdotL);
+		return emitted() * (Real(1) / (dist * dist) * NdotL);
 	}
 };
 
@@ -2,56 +2,71 @@
 
 #include <cstdint>
 #include <stdexcept>
-#include <random>
 #include <algorithm>
 #include <cmath>
+#include <bit>
+#include <tuple>
+#include "Sampler.h"
 
-struct Vec3 {
-    double x, y, z;
-    explicit Vec3(const double x = 0.0, const double y = 0.0, const double z = 0.0) : x(x), y(y), z(z) {}
-    explicit Vec3(const double v) : x(v), y(v), z(v) {}
-
-    Vec3 operator+(const Vec3& o) const noexcept { return Vec3{ x + o.x, y + o.y, z + o.z }; }
-    Vec3 operator+(const double s) const noexcept { return Vec3{ x + s, y + s, z + s }; }
-    Vec3 operator-(const Vec3& o) const noexcept { return Vec3{ x - o.x, y - o.y, z - o.z }; }
-    Vec3 operator-(const double s) const noexcept { return Vec3{ x - s, y - s, z - s }; }
-    Vec3 operator*(const double s) const noexcept { return Vec3{ x * s, y * s, z * s }; }
-    Vec3 operator*(const Vec3& o) const noexcept { return Vec3{ x * o.x, y * o.y, z * o.z }; }
-    Vec3 operator/(const Vec3& o) const noexcept { return Vec3{ x / o.x, y / o.y, z / o.z }; }
-    Vec3 operator/(const double s) const noexcept { return Vec3{ x / s, y / s, z / s }; }
-    Vec3& operator+=(const Vec3& o) noexcept { x += o.x; y += o.y; z += o.z; return *this; }
-    Vec3 operator-() const noexcept { return Vec3{ -x, -y, -z }; }
-    Vec3& operator/=(const double s) noexcept { x /= s; y /= s; z /= s; return *this; }
-    Vec3& operator*=(const double s) noexcept { x *= s; y *= s; z *= s; return *this; }
-
-    double dot(const Vec3& o) const noexcept { return x * o.x + y * o.y + z * o.z; }
-    Vec3 cross(const Vec3& o) const noexcept { return Vec3{ y * o.z - z * o.y, z * o.x - x * o.z, x * o.y - y * o.x }; }
-
-    double length() const noexcept { return std::sqrt(dot(*this)); }
-    Vec3 normalize() const noexcept {
-        double len = length();
-        if (len <= 1e-12) {
-            return Vec3{ 0, 0, 0 };
+// Scalar type of the whole renderer, define RAYTRACING_SINGLE_PRECISION to render in float.
+// Self-intersection robustness does not rely on double precision: secondary rays start
+// from OffsetRayOrigin and mesh triangles use a watertight test.
+#if defined(RAYTRACING_SINGLE_PRECISION)
+using Real = float;
+#else
+using Real = double;
+#endif
+
+template <typename T>
+struct TVec3 {
+    T x, y, z;
+    explicit TVec3(const T x = T(0), const T y = T(0), const T z = T(0)) : x(x), y(y), z(z) {}
+    explicit TVec3(const T v) : x(v), y(v), z(v) {}
+    template <typename U>
+    explicit TVec3(const TVec3<U>& o) : x(static_cast<T>(o.x)), y(static_cast<T>(o.y)), z(static_cast<T>(o.z)) {}
+
+    TVec3 operator+(const TVec3& o) const noexcept { return TVec3{ x + o.x, y + o.y, z + o.z }; }
+    TVec3 operator+(const T s) const noexcept { return TVec3{ x + s, y + s, z + s }; }
+    TVec3 operator-(const TVec3& o) const noexcept { return TVec3{ x - o.x, y - o.y, z - o.z }; }
+    TVec3 operator-(const T s) const noexcept { return TVec3{ x - s, y - s, z - s }; }
+    TVec3 operator*(const T s) const noexcept { return TVec3{ x * s, y * s, z * s }; }
+    TVec3 operator*(const TVec3& o) const noexcept { return TVec3{ x * o.x, y * o.y, z * o.z }; }
+    TVec3 operator/(const TVec3& o) const noexcept { return TVec3{ x / o.x, y / o.y, z / o.z }; }
+    TVec3 operator/(const T s) const noexcept { return TVec3{ x / s, y / s, z / s }; }
+    TVec3& operator+=(const TVec3& o) noexcept { x += o.x; y += o.y; z += o.z; return *this; }
+    TVec3 operator-() const noexcept { return TVec3{ -x, -y, -z }; }
+    TVec3& operator/=(const T s) noexcept { x /= s; y /= s; z /= s; return *this; }
+    TVec3& operator*=(const T s) noexcept { x *= s; y *= s; z *= s; return *this; }
+    bool operator==(const TVec3&) const noexcept = default;
+
+    T dot(const TVec3& o) const noexcept { return x * o.x + y * o.y + z * o.z; }
+    TVec3 cross(const TVec3& o) const noexcept { return TVec3{ y * o.z - z * o.y, z * o.x - x * o.z, x * o.y - y * o.x }; }
+
+    T length() const noexcept { return std::sqrt(dot(*this)); }
+    TVec3 normalize() const noexcept {
+        T len = length();
+        if (len <= T(1e-12)) {
+            return TVec3{ 0, 0, 0 };
         }
         return (*this) / len;
     }
 
-    Vec3 reflect(const Vec3& normal) const noexcept {
-        return (*this) - normal * 2.0 * this->dot(normal);
+    TVec3 reflect(const TVec3& normal) const noexcept {
+        return (*this) - normal * T(2) * this->dot(normal);
     }
 
-    Vec3 refract(const Vec3& normal, double eta) const {
-        const Vec3 I = this->normalize();
-        const Vec3 N = normal.normalize();
-        const double cosi = std::clamp(I.dot(N), -1.0, 1.0);
-        const double k = 1.0 - eta * eta * (1.0 - cosi * cosi);
-        if (k < 0.0) {
-            return Vec3{ 0,0,0 };
+    TVec3 refract(const TVec3& normal, T eta) const {
+        const TVec3 I = this->normalize();
+        const TVec3 N = normal.normalize();
+        const T cosi = std::clamp(I.dot(N), T(-1), T(1));
+        const T k = T(1) - eta * eta * (T(1) - cosi * cosi);
+        if (k < T(0)) {
+            return TVec3{ 0,0,0 };
         }
         return I * eta - N * (eta * cosi + std::sqrt(k));
     }
 
-    double unsafeIndex(const int index) const {
+    T unsafeIndex(const int index) const {
         switch (index) {
             case 0: return x;
             case 1: return y;
@@ -60,14 +75,137 @@ struct Vec3 {
         }
     }
 
-    Vec3& lerp(const Vec3& target, const double t) noexcept {
+    TVec3& lerp(const TVec3& target, const T t) noexcept {
         x = x + (target.x - x) * t;
         y = y + (target.y - y) * t;
         z = z + (target.z - z) * t;
         return *this;
     }
 
-    friend Vec3 operator*(double s, const Vec3& v) noexcept { return v * s; }
+    friend TVec3 operator*(T s, const TVec3& v) noexcept { return v * s; }
+};
+
+using Vec3 = TVec3<Real>;
+
+// Moves a hit point off its surface along the geometric normal n (pointing to the side the new
+// ray leaves from) by a few ulps of the single precision triangle kernel, after Waechter and Binder,
+// "A Fast and Robust Method for Avoiding Self-Intersection" (Ray Tracing Gems, chapter 6).
+template <typename T>
+TVec3<T> OffsetRayOrigin(const TVec3<T>& p, const TVec3<T>& n) noexcept {
+    constexpr float ORIGIN = 1.0f / 32.0f;
+    constexpr float FLOAT_SCALE = 1.0f / 65536.0f;
+    constexpr float INT_SCALE = 256.0f;
+
+    const auto offsetComponent = [&](const T pc, const T nc) {
+        const float pf = static_cast<float>(pc);
+        const int32_t ofi = static_cast<int32_t>(INT_SCALE * static_cast<float>(nc));
+        const int32_t bits = std::bit_cast<int32_t>(pf);
+        const float pi = std::bit_cast<float>(bits + ((pf < 0.0f) ? -ofi : ofi));
+        if (std::abs(pf) < ORIGIN) {
+            return static_cast<T>(pc + static_cast<T>(FLOAT_SCALE) * nc);
+        }
+        // keep the full precision of pc and only add the float sized offset
+        return static_cast<T>(pc + (static_cast<T>(pi) - static_cast<T>(pf)));
+    };
+
+    return TVec3<T>{ offsetComponent(p.x, n.x), offsetComponent(p.y, n.y), offsetComponent(p.z, n.z) };
+}
+
+// Affine transform stored as the 3 top rows of a 4x4 row-major matrix.
+struct Matrix3x4 {
+    Real m[3][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 } };
+
+    static Matrix3x4 Identity() noexcept { return Matrix3x4{}; }
+
+    // scale, then rotation around X, Y and Z (radians), then translation
+    static Matrix3x4 FromTRS(const Vec3& translation, const Vec3& rotation, const Vec3& scale) noexcept {
+        const Real cx = std::cos(rotation.x), sx = std::sin(rotation.x);
+        const Real cy = std::cos(rotation.y), sy = std::sin(rotation.y);
+        const Real cz = std::cos(rotation.z), sz = std::sin(rotation.z);
+
+        // R = Rz * Ry * Rx
+        const Real r[3][3] = {
+            { cz * cy, cz * sy * sx - sz * cx, cz * sy * cx + sz * sx },
+            { sz * cy, sz * sy * sx + cz * cx, sz * sy * cx - cz * sx },
+            { -sy,     cy * sx,                cy * cx }
+        };
+
+        Matrix3x4 result;
+        for (int row = 0; row < 3; ++row) {
+            result.m[row][0] = r[row][0] * scale.x;
+            result.m[row][1] = r[row][1] * scale.y;
+            result.m[row][2] = r[row][2] * scale.z;
+        }
+        result.m[0][3] = translation.x;
+        result.m[1][3] = translation.y;
+        result.m[2][3] = translation.z;
+        return result;
+    }
+
+    Vec3 TransformPoint(const Vec3& p) const noexcept {
+        return Vec3{
+            m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+            m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+            m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]
+        };
+    }
+
+    Vec3 TransformVector(const Vec3& v) const noexcept {
+        return Vec3{
+            m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+            m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+            m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z
+        };
+    }
+
+    // Multiplies by the transposed linear part, called on the inverse matrix it transforms normals
+    Vec3 TransposeTransformVector(const Vec3& v) const noexcept {
+        return Vec3{
+            m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+            m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+            m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z
+        };
+    }
+
+    Matrix3x4 operator*(const Matrix3x4& o) const noexcept {
+        Matrix3x4 result;
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 4; ++col) {
+                result.m[row][col] = m[row][0] * o.m[0][col] + m[row][1] * o.m[1][col] + m[row][2] * o.m[2][col];
+            }
+            result.m[row][3] += m[row][3];
+        }
+        return result;
+    }
+
+    Matrix3x4 Inverse() const {
+        const Real det =
+            m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+            m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+            m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        if (std::abs(det) <= 1e-18) {
+            throw std::invalid_argument("Matrix3x4 is not invertible");
+        }
+
+        const Real invDet = Real(1) / det;
+        Matrix3x4 inv;
+        inv.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * invDet;
+        inv.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * invDet;
+        inv.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * invDet;
+        inv.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * invDet;
+        inv.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * invDet;
+        inv.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * invDet;
+        inv.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * invDet;
+        inv.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * invDet;
+        inv.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * invDet;
+
+        const Vec3 t{ m[0][3], m[1][3], m[2][3] };
+        const Vec3 invT = inv.TransformVector(t);
+        inv.m[0][3] = -invT.x;
+        inv.m[1][3] = -invT.y;
+        inv.m[2][3] = -invT.z;
+        return inv;
+    }
 };
 
 struct Color {
@@ -75,41 +213,55 @@ struct Color {
     Color(const uint8_t r = 0, const uint8_t g = 0, const uint8_t b = 0) : r(r), g(g), b(b) {}
 };
 
-struct Rayon {
-    Vec3 origin;
-    Vec3 direction;
-    Rayon(const Vec3& o, const Vec3& d) : origin(o), direction(d) {}
-    Vec3 pointAtDistance(const double t) const noexcept { return origin + direction * t; }
+template <typename T>
+struct TRayon {
+    TVec3<T> origin;
+    TVec3<T> direction;
+    TRayon(const TVec3<T>& o, const TVec3<T>& d) : origin(o), direction(d) {}
+    TVec3<T> pointAtDistance(const T t) const noexcept { return origin + direction * t; }
 };
 
+using Rayon = TRayon<Real>;
+
 struct Camera {
     Vec3 position;
     Vec3 forward;
     std::size_t width;
     std::size_t height;
-    double focal;
-    double farPlaneDistance;
-    double nearPlaneDistance;
+    Real focal;
+    Real farPlaneDistance;
+    Real nearPlaneDistance;
 
-    int antiAliasingAmount = 32;
+    // echantillonnage adaptatif par pixel, voir Scene::GeneratePixelAt
+    int minSamples = 4;
+    int maxSamples = 32;
+    Real sampleErrorThreshold = Real(0.01); // demi-largeur de l'intervalle de confiance, relative a la luminance
 
-    Camera(const Vec3& position, double focal = 1.0, std::size_t width = 800, std::size_t height = 600, double nearPlaneDistance = 1.0, double farPlaneDistance = 1000.0)
+    Camera(const Vec3& position, Real focal = 1, std::size_t width = 800, std::size_t height = 600, Real nearPlaneDistance = 1, Real farPlaneDistance = 1000)
         : position(position), forward{0,0,1}, width(width), height(height), focal(focal), farPlaneDistance(farPlaneDistance), nearPlaneDistance(nearPlaneDistance) {}
 
-    Rayon getRay(const size_t pixelX, const size_t pixelY, const bool aa) const {
-        auto sx = (static_cast<double>(pixelX) ) - static_cast<double>(width) / 2.0;
-        auto sy = static_cast<double>(height) / 2.0 - (static_cast<double>(pixelY));
+    Sampler sampler; // sequence des decalages sous-pixel, hash de la roulette russe
+
+    uint32_t pixelIndex(const size_t pixelX, const size_t pixelY) const noexcept {
+        return static_cast<uint32_t>(pixelY * width + pixelX);
+    }
+
+    // Nombre d'echantillons tires au plus par pixel : minSamples l'emporte sur un maxSamples plus petit
+    int SampleCount() const noexcept {
+        return std::max({ 1, minSamples, maxSamples });
+    }
 
-        auto jitterX = 0.0;
-        auto jitterY = 0.0;
-        if (aa) {
-            const auto invAA = 1.0 / static_cast<double>(aa);
+    // Avec un seul echantillon le rayon passe par le coin du pixel, sinon l'echantillon sampleIndex
+    // parmi sampleCount (SampleCount() pour un rendu) est place dans [0, 1)^2 par la sequence du sampler
+    Rayon getRay(const size_t pixelX, const size_t pixelY, const uint32_t sampleIndex, const uint32_t sampleCount) const {
+        auto sx = (static_cast<Real>(pixelX) ) - static_cast<Real>(width) / Real(2);
+        auto sy = static_cast<Real>(height) / Real(2) - (static_cast<Real>(pixelY));
 
-            // suggestion Chatgpt : use thread_local random generators to avoid contention in multithreaded scenarios
-            thread_local static std::mt19937 gen((std::random_device())());
-            thread_local static std::uniform_real_distribution<double> dist(0.0, 1.0);
-            jitterX = dist(gen) * invAA;
-            jitterY = dist(gen) * invAA;
+        auto jitterX = Real(0);
+        auto jitterY = Real(0);
+        if (sampleCount > 1) {
+            std::tie(jitterX, jitterY) = sampler.Sample2D<Real>(static_cast<uint32_t>(pixelX), static_cast<uint32_t>(pixelY),
+                pixelIndex(pixelX, pixelY), sampleIndex, sampleCount, SAMPLE_PIXEL);
         }
 
         sx += jitterX;
@@ -3,16 +3,23 @@
 #include "Light.h"
 #include "Shape.h"
 #include "Scene.h"
+#include "ThreadPool.h"
+#include "Tonemap.h"
+#include "Stats.h"
+#include "Heatmap.h"
+#include "Trace.h"
 
 #include <vector>
 #include <filesystem>
 
+#include <atomic>
 #include <iostream>
+#include <mutex>
 #include <stdlib.h>
 
 #include "tiny_obj_loader.h"
 
-Model LoadObject(const std::string& modelName, const Transform& transform = Transform(), const Material& material = Material()) {
+std::shared_ptr<const Mesh> LoadMesh(const std::string& modelName) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
@@ -38,187 +45,55 @@ Model LoadObject(const std::string& modelName, const Transform& transform = Tran
         throw std::runtime_error("Failed to load/parse .obj.");
     }
 
-    std::vector<Vec3> vertices;
-    vertices.reserve(attrib.vertices.size() / 3);
-    for (size_t v = 0; v < attrib.vertices.size() / 3; v++) {
-        vertices.emplace_back(
-            attrib.vertices[3 * v + 0],
-            attrib.vertices[3 * v + 1],
-            attrib.vertices[3 * v + 2]
-        );
-    }
-
-    std::vector<int> indices;
-    indices.reserve([&shapes] {
-        size_t count = 0;
-        for (const auto& s : shapes) { count += s.mesh.indices.size(); }
-        return count;
-    }());
-    for (const auto& shape : shapes) {
-        for (const auto& index : shape.mesh.indices) {
-            indices.push_back(index.vertex_index);
+    // conversion des sommets et des indices repartie sur le pool, chaque forme ecrit sa propre tranche
+    ThreadPool& pool = ThreadPool::Global();
+    std::vector<Vec3> vertices(attrib.vertices.size() / 3);
+    pool.ParallelFor(0, vertices.size(), 16384, [&](const size_t begin, const size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            vertices[v] = Vec3(
+                attrib.vertices[3 * v + 0],
+                attrib.vertices[3 * v + 1],
+                attrib.vertices[3 * v + 2]
+            );
         }
-    }
-
-    // Return model with provided transform and material so triangles derive offset later
-    return Model(indices, transform, material, vertices);
-}
-
-constexpr auto WIDTH = 1000;
-constexpr auto HEIGHT = 1000;
-
-Vec3 ClampVec3(const Vec3& v, double minVal = 0.0, double maxVal = 1.0) {
-	return Vec3(
-		std::min(maxVal, std::max(minVal, v.x)),
-		std::min(maxVal, std::max(minVal, v.y)),
-		std::min(maxVal, std::max(minVal, v.z))
-	);
-}
-
-Vec3 uncharted2_tonemap_partial(Vec3 x)
-{
-    float A = 0.15f;
-    float B = 0.50f;
-    float C = 0.10f;
-    float D = 0.20f;
-    float E = 0.02f;
-    float F = 0.30f;
-    return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
-}
-
-Vec3 aces_approx(Vec3 v)
-{
-	v *= 0.6f;
-	float a = 2.51f;
-	float b = 0.03f;
-	float c = 2.43f;
-	float d = 0.59f;
-	float e = 0.14f;
-	return ClampVec3((v * (a * v + b)) / (v * (c * v + d) + e), 0.0f, 1.0f);
-}
-
-double luminance(const Vec3& color)
-{
-	Vec3 luminanceWeights = Vec3(0.2126, 0.7152, 0.0722);
-	return color.dot(luminanceWeights);
-}
-
-Vec3 change_luminance(Vec3 c_in, double l_out)
-{
-	double l_in = luminance(c_in);
-	return c_in * (l_out / l_in);
-}
-
-
-Color toColor(const Vec3& pixel)
-{
-    Vec3 clamped = ClampVec3(pixel);
-    return Color(
-        static_cast<uint8_t>(clamped.x * 255.0),
-        static_cast<uint8_t>(clamped.y * 255.0),
-        static_cast<uint8_t>(clamped.z * 255.0)
-    );
-}
-
-Vec3 simple(const Vec3& color)
-{
-	Vec3 mapped = Vec3(
-		std::min(1.0, std::max(0.0, color.x)),
-		std::min(1.0, std::max(0.0, color.y)),
-		std::min(1.0, std::max(0.0, color.z))
-	);
-	return mapped;
-}
-
-Vec3 reinhardSimple(const Vec3& color) {
-	return color / (color + 1);
-}
+    });
 
-Vec3 reinhardExtended(const Vec3 color, double max_white) {
-	double white_sq = max_white * max_white;
-	Vec3 numerator = color * ((color / Vec3(white_sq, white_sq, white_sq)) + 1);
-	return numerator / (color + 1);
-}
-
-Vec3 reinhardExtendedLuminance(const Vec3& color, double maxWhite) {
-	double L_old = luminance(color);
-	double numerator = L_old * (1 + (L_old / (maxWhite * maxWhite)));
-	double l_new = numerator / (1 + L_old);
-	return change_luminance(color, l_new);
-}
-
-Vec3 reinhardJodie(const Vec3& color, double a = 0.18) {
-	double L = luminance(color);
-	double L_mapped = (a / std::log(2 + std::pow((L / 0.85), 1.7))) * std::log(1 + L);
-	return change_luminance(color, L_mapped);
-}
-
-Vec3 uncharted2(const Vec3& color) {
-	double exposureBias = 2.0f;
-	Vec3 curr = uncharted2_tonemap_partial(color * exposureBias);
+    std::vector<size_t> shapeOffsets(shapes.size() + 1, 0);
+    for (size_t s = 0; s < shapes.size(); s++) {
+        shapeOffsets[s + 1] = shapeOffsets[s] + shapes[s].mesh.indices.size();
+    }
+    std::vector<int> indices(shapeOffsets.back());
+    pool.ParallelFor(0, shapes.size(), 1, [&](const size_t begin, const size_t end) {
+        for (size_t s = begin; s < end; s++) {
+            const auto& shapeIndices = shapes[s].mesh.indices;
+            for (size_t i = 0; i < shapeIndices.size(); i++) {
+                indices[shapeOffsets[s] + i] = shapeIndices[i].vertex_index;
+            }
+        }
+    });
 
-	Vec3 W = Vec3(11.2, 11.2, 11.2);
-	Vec3 whiteScale = Vec3(1,1,1) / uncharted2_tonemap_partial(W);
-	return curr * whiteScale;
+    return std::make_shared<const Mesh>(std::move(indices), std::move(vertices));
 }
 
-std::vector<Color> tonemap(const std::vector<Vec3>& pixels)
-{
-	std::vector<Color> colorPixels = std::vector<Color>(pixels.size());
-	for (size_t i = 0; i < pixels.size(); i++) {
-		Vec3 current = pixels[i];
-		Vec3 mapped = aces_approx(current);
-		colorPixels[i] = toColor(mapped);
-	}
-	return colorPixels;
+// Every Model created from the same mesh shares its vertex buffers and BVH
+Model LoadObject(const std::string& modelName, const Transform& transform = Transform(), const MaterialId material = 0) {
+    TRACE_SCOPE("LoadObject", "load");
+    return Model(LoadMesh(modelName), transform, material);
 }
 
-std::vector<std::vector<Color>> tonemapAll(const std::vector<Vec3> pixels)
-{
-	std::vector<std::vector<Color>> allTonemapped;
-	std::vector<Color> simpleMapped(pixels.size());
-	std::vector<Color> reinhardSimpleMapped(pixels.size());
-	std::vector<Color> reinhardExtendedMapped(pixels.size());
-	std::vector<Color> reinhardExtendedLuminanceMapped(pixels.size());
-	std::vector<Color> reinhardJodieMapped(pixels.size());
-	std::vector<Color> uncharted2Mapped(pixels.size());
-	std::vector<Color> acesMapped(pixels.size());
-
-	for (size_t i = 0; i < pixels.size(); i++) {
-		Vec3 current = pixels[i];
-		Vec3 simpleColor = simple(current);
-		simpleMapped[i] = toColor(simpleColor);
-		Vec3 reinhardSimpleColor = reinhardSimple(current);
-		reinhardSimpleMapped[i] = toColor(reinhardSimpleColor);
-		Vec3 reinhardExtendedColor = reinhardExtended(current, 5.0);
-		reinhardExtendedMapped[i] = toColor(reinhardExtendedColor);
-		Vec3 reinhardExtendedLuminanceColor = reinhardExtendedLuminance(current, 5.0);
-		reinhardExtendedLuminanceMapped[i] = toColor(reinhardExtendedLuminanceColor);
-		Vec3 reinhardJodieColor = reinhardJodie(current);
-		reinhardJodieMapped[i] = toColor(reinhardJodieColor);
-		Vec3 uncharted2Color = uncharted2(current);
-		uncharted2Mapped[i] = toColor(uncharted2Color);
-		Vec3 acesColor = aces_approx(current);
-		acesMapped[i] = toColor(acesColor);
-	}
-
-	allTonemapped.push_back(simpleMapped);
-	allTonemapped.push_back(reinhardSimpleMapped);
-	allTonemapped.push_back(reinhardExtendedMapped);
-	allTonemapped.push_back(reinhardExtendedLuminanceMapped);
-	allTonemapped.push_back(reinhardJodieMapped);
-	allTonemapped.push_back(uncharted2Mapped);
-	allTonemapped.push_back(acesMapped);
-
-	return allTonemapped;
-}
+constexpr auto WIDTH = 1000;
+constexpr auto HEIGHT = 1000;
+constexpr bool COST_HEATMAP = false; // ecrit heatmap_*.png et heatmap.exr (cout de rendu par pixel)
+constexpr bool CHROME_TRACE = false; // ecrit trace.json (chronologie des etapes et des tuiles, pour Perfetto)
 
 int main()
 {
-	#ifdef _OPENMP
-	int n_threads = omp_get_max_threads();
+	if constexpr (CHROME_TRACE) {
+		Tracer::SetThreadName("main");
+		Tracer::Start();
+	}
+	unsigned n_threads = ThreadPool::Global().ThreadCount();
 	std::cout << "Nombre de threads par défaut : " << n_threads << "\n";
-	#endif
 
 	Vec3 origin(0, 0, -25);
 	Camera camera(origin, 500, WIDTH, HEIGHT, 0, 200);
@@ -247,7 +122,7 @@ int main()
 	};
 
 	Transform monkeyTransform { Vec3(0, 0, 10), Vec3(0,0,0), Vec3(1,1,1) };
-	auto monkey = LoadObject("box.obj", monkeyTransform, monkeyMaterial);
+	auto monkey = LoadObject("box.obj", monkeyTransform, scene.AddMaterial(monkeyMaterial));
 	scene.AddModel(monkey);
 
 	double distance = 15;
@@ -279,7 +154,7 @@ int main()
 		mat.shininess = 0.128;
 		mat.refractiveIndex = 1.5;
 
-        Plane plane(dir * -distance, dir, mat);
+        Plane plane(dir * -distance, dir, scene.AddMaterial(mat));
         scene.AddPlane(plane);
 	}
 
@@ -289,6 +164,28 @@ int main()
 	scene.AddLight(firstLight);
 	scene.AddLight(secondLight);
 
+	// une ligne par pourcent : seul le thread qui fait avancer le pourcentage prend le verrou et flush
+	std::atomic<int> reachedPercent{ -1 };
+	std::mutex progressMutex;
+	int printedPercent = -1; // protege par progressMutex
+	scene.SetProgressCallback([&](const size_t done, const size_t total) {
+		const int percent = static_cast<int>(done * 100 / total);
+		int previous = reachedPercent.load(std::memory_order_relaxed);
+		do {
+			if (percent <= previous) {
+				return;
+			}
+		} while (!reachedPercent.compare_exchange_weak(previous, percent, std::memory_order_relaxed));
+
+		const std::lock_guard lock(progressMutex);
+		if (percent > printedPercent) {
+			printedPercent = percent;
+			std::cout << "\rRendu : " << percent << " %" << (done == total ? "\n" : "") << std::flush;
+		}
+	});
+
+	scene.SetCostMap(COST_HEATMAP);
+	Stats::Reset();
 	auto gen_start = std::chrono::high_resolution_clock::now();
 	std::vector<Vec3> pixels = scene.RenderImage();
 	auto gen_end = std::chrono::high_resolution_clock::now();
@@ -297,33 +194,46 @@ int main()
 	double gen_s = static_cast<double>(gen_ms) / 1000.0;
 
 	std::cout << "Temps de génération de l'image : " << gen_ms << " ms (" << gen_s << " s)\n";
+	if constexpr (STATS_ENABLED) {
+		Stats::Collect().Print(std::cout, gen_s);
+	}
 
-	std::vector<Color> colorPixels = tonemap(pixels);
-
-	std::vector<std::string> tonemapNames = {
-		"simple",
-		"reinhard_simple",
-		"reinhard_extended",
-		"reinhard_extended_luminance",
-		"reinhard_jodie",
-		"uncharted2",
-		"aces"
-	};
+	// buffers de sortie possedes ici, remplis en une passe sur l'image HDR
+	auto tm_start = std::chrono::high_resolution_clock::now();
+	std::vector<std::vector<Color>> allTonemapped;
+	std::vector<TonemapTarget> tonemapTargets;
+	for (const TonemapOperator op : ALL_TONEMAP_OPERATORS) {
+		allTonemapped.emplace_back(pixels.size());
+		tonemapTargets.push_back({ op, allTonemapped.back() });
+	}
+	tonemap(pixels, tonemapTargets);
+	auto tm_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Temps de tonemapping : " << std::chrono::duration_cast<std::chrono::milliseconds>(tm_end - tm_start).count() << " ms\n";
 
-	std::vector<std::vector<Color>> allTonemapped = tonemapAll(pixels);
+	// une tache par image, le PNG est encode en memoire puis ecrit en une fois
+	auto out_start = std::chrono::high_resolution_clock::now();
+	TaskGroup outputTasks;
 	for (size_t i = 0; i < allTonemapped.size(); i++) {
-		std::string tmFilename = tonemapNames[i];
-		writePPM(tmFilename + ".ppm", allTonemapped[i], WIDTH, HEIGHT);
-		std::string command = "ffmpeg -y -loglevel error -i \"" + tmFilename + ".ppm\" -frames:v 1 \"" + tmFilename + ".png\"";
-		int rc = std::system(command.c_str());
-		if (rc == 0 && std::filesystem::exists(tmFilename + ".png")) {
-			std::cout << "Conversion PPM -> PNG réussie :" << tmFilename << ".png\n";
-			std::string deleteCommand = "del \"" + tmFilename + ".ppm\"";
-			std::system(deleteCommand.c_str());
-		}
-		else {
-			std::cerr << "Conversion PPM -> PNG échouée (code: " << rc << "). Vérifier que ffmpeg est installé et dans le PATH.\n";
-		}
+		outputTasks.Run([&, i] {
+			writePNG(std::string(tonemapName(tonemapTargets[i].op)) + ".png", allTonemapped[i], WIDTH, HEIGHT);
+		});
+	}
+	// buffer HDR brut, avant tonemapping
+	outputTasks.Run([&] {
+		writeEXR("output.exr", pixels, WIDTH, HEIGHT);
+	});
+	if constexpr (COST_HEATMAP) {
+		outputTasks.Run([&] {
+			writeHeatmaps("heatmap", scene.GetCostMap(), WIDTH, HEIGHT);
+		});
+	}
+	outputTasks.Wait();
+	auto out_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Temps d'écriture des images : " << std::chrono::duration_cast<std::chrono::milliseconds>(out_end - out_start).count() << " ms\n";
+
+	if constexpr (CHROME_TRACE) {
+		Tracer::Stop();
+		Tracer::Write("trace.json");
 	}
 
 	return 0;
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <limits>
+
+// Dimensions des echantillons d'un pixel. Les dimensions 2D (sous-pixel, puis lumiere, glossy...)
+// passent par Sampler::Sample2D, les decisions 1D par Sampler::Uniform.
+enum SampleDimension : uint32_t {
+    SAMPLE_PIXEL = 0,    // decalage sous-pixel (2D)
+    SAMPLE_ROULETTE = 1, // roulette russe, une valeur par sommet du chemin
+};
+
+// Generateur de nombres sans etat : chaque valeur ne depend que de (graine, pixel, echantillon,
+// dimension, chemin), hachee avec le hash PCG de Jarzynski et Olano (JCGT 2020).
+// Le resultat ne depend ni du thread ni de l'ordre de rendu, une image peut donc etre
+// reproduite au bit pres et decoupee entre plusieurs machines.
+class CounterSampler {
+private:
+    uint32_t seed = 0;
+
+public:
+    CounterSampler() = default;
+    explicit CounterSampler(const uint32_t seed) : seed(seed) {}
+
+    static constexpr uint32_t PcgHash(const uint32_t value) noexcept {
+        const uint32_t state = value * 747796405u + 2891336453u;
+        const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+
+    uint32_t Seed() const noexcept { return seed; }
+    void SetSeed(const uint32_t value) noexcept { seed = value; }
+
+    // path identifie un sommet du chemin (1 pour le rayon primaire, 2 * id + branche pour ses rebonds)
+    uint32_t Hash(const uint32_t pixel, const uint32_t sampleIndex, const uint32_t dimension, const uint64_t path = 0) const noexcept {
+        uint32_t h = PcgHash(seed ^ PcgHash(pixel));
+        h = PcgHash(h ^ sampleIndex);
+        h = PcgHash(h ^ dimension);
+        if (path != 0) {
+            h = PcgHash(h ^ static_cast<uint32_t>(path));
+            h = PcgHash(h ^ static_cast<uint32_t>(path >> 32));
+        }
+        return h;
+    }
+
+    // Valeur uniforme dans [0, 1)
+    template <typename T>
+    T Uniform(const uint32_t pixel, const uint32_t sampleIndex, const uint32_t dimension, const uint64_t path = 0) const noexcept {
+        return ToUnit<T>(Hash(pixel, sampleIndex, dimension, path));
+    }
+
+    template <typename T>
+    static T ToUnit(const uint32_t bits) noexcept {
+        static_assert(std::is_floating_point_v<T>);
+        if constexpr (sizeof(T) == sizeof(float)) {
+            return static_cast<T>(bits >> 8) * T(1.0 / 16777216.0);
+        } else {
+            return static_cast<T>(bits) * T(1.0 / 4294967296.0);
+        }
+    }
+};
+
+// Masque de bruit bleu SIZE x SIZE genere une fois par void-and-cluster (Ulichney 1993),
+// energie gaussienne (sigma = 1.5) sur un tore. Value(x, y) est le rang normalise du pixel dans [0, 1).
+class BlueNoiseMask {
+public:
+    static constexpr uint32_t SIZE = 64;
+
+private:
+    std::vector<float> values;
+
+    // Pixels du motif et energie de chaque case, mise a jour a chaque ajout ou retrait
+    struct Pattern {
+        std::vector<uint8_t> bits;
+        std::vector<float> energy;
+        const std::vector<float>* kernel;
+
+        explicit Pattern(const std::vector<float>& kernel) : bits(SIZE * SIZE, 0), energy(SIZE * SIZE, 0.0f), kernel(&kernel) {}
+
+        void Toggle(const uint32_t index, const bool set) {
+            bits[index] = set ? 1 : 0;
+            const float sign = set ? 1.0f : -1.0f;
+            const uint32_t px = index % SIZE, py = index / SIZE;
+            for (uint32_t y = 0; y < SIZE; ++y) {
+                const uint32_t dy = (y + SIZE - py) % SIZE;
+                for (uint32_t x = 0; x < SIZE; ++x) {
+                    energy[y * SIZE + x] += sign * (*kernel)[dy * SIZE + (x + SIZE - px) % SIZE];
+                }
+            }
+        }
+
+        // plus forte energie parmi les 1 (amas le plus serre), ou plus faible parmi les 0 (plus grand vide)
+        uint32_t Find(const bool tightestCluster) const {
+            uint32_t best = 0;
+            float bestEnergy = tightestCluster ? -1e30f : 1e30f;
+            for (uint32_t i = 0; i < SIZE * SIZE; ++i) {
+                if ((bits[i] != 0) != tightestCluster) {
+                    continue;
+                }
+                if (tightestCluster ? energy[i] > bestEnergy : energy[i] < bestEnergy) {
+                    bestEnergy = energy[i];
+                    best = i;
+                }
+            }
+            return best;
+        }
+    };
+
+    BlueNoiseMask() {
+        constexpr uint32_t COUNT = SIZE * SIZE;
+        constexpr float SIGMA = 1.5f;
+        std::vector<float> kernel(COUNT);
+        for (uint32_t y = 0; y < SIZE; ++y) {
+            for (uint32_t x = 0; x < SIZE; ++x) {
+                const float dx = static_cast<float>(std::min(x, SIZE - x));
+                const float dy = static_cast<float>(std::min(y, SIZE - y));
+                kernel[y * SIZE + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * SIGMA * SIGMA));
+            }
+        }
+
+        // motif initial : 10% de pixels au hasard, puis deplace des amas vers les vides jusqu'a stabilite
+        Pattern initial(kernel);
+        uint32_t ones = 0;
+        for (uint32_t i = 0; i < COUNT; ++i) {
+            if (CounterSampler::PcgHash(i ^ 0x9e3779b9u) % 10 == 0) {
+                initial.Toggle(i, true);
+                ++ones;
+            }
+        }
+        for (uint32_t iteration = 0; iteration < COUNT; ++iteration) {
+            const uint32_t cluster = initial.Find(true);
+            initial.Toggle(cluster, false);
+            const uint32_t voidIndex = initial.Find(false);
+            initial.Toggle(voidIndex, true);
+            if (voidIndex == cluster) {
+                break;
+            }
+        }
+
+        std::vector<uint32_t> rank(COUNT, 0);
+        // phase 1 : les 1 du motif initial, du plus serre au moins serre
+        Pattern pattern = initial;
+        for (uint32_t r = ones; r-- > 0;) {
+            const uint32_t cluster = pattern.Find(true);
+            pattern.Toggle(cluster, false);
+            rank[cluster] = r;
+        }
+        // phases 2 et 3 : remplit les vides un par un (le plus grand vide est aussi l'amas
+        // de 0 le plus serre du motif inverse)
+        pattern = initial;
+        for (uint32_t r = ones; r < COUNT; ++r) {
+            const uint32_t voidIndex = pattern.Find(false);
+            pattern.Toggle(voidIndex, true);
+            rank[voidIndex] = r;
+        }
+
+        values.resize(COUNT);
+        for (uint32_t i = 0; i < COUNT; ++i) {
+            values[i] = (static_cast<float>(rank[i]) + 0.5f) / static_cast<float>(COUNT);
+        }
+    }
+
+public:
+    static const BlueNoiseMask& Get() {
+        static const BlueNoiseMask mask;
+        return mask;
+    }
+
+    float Value(const uint32_t x, const uint32_t y) const noexcept {
+        return values[(y % SIZE) * SIZE + (x % SIZE)];
+    }
+};
+
+enum class SamplerType {
+    RANDOM,     // hash independant par echantillon
+    STRATIFIED, // grille ceil(sqrt(n))^2 parcourue dans un ordre permute par pixel, jitter dans chaque strate
+    SOBOL,      // (0,2)-sequence de Sobol, brouillage d'Owen par hash (Burley 2020)
+    BLUE_NOISE, // suite R2 decalee par un masque de bruit bleu (rotation de Cranley-Patterson)
+};
+
+// Sequences d'echantillons pluggables pour les dimensions 2D, les tirages 1D (roulette)
+// restent sur le hash de CounterSampler.
+class Sampler {
+private:
+    CounterSampler counter;
+    SamplerType type = SamplerType::SOBOL;
+
+    // les dimensions hachees des sequences 2D sont separees de celles de Uniform
+    static constexpr uint32_t HASH_DIMENSION_2D = 0x100;
+
+    static uint32_t ReverseBits(uint32_t x) noexcept {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+        x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    // Permutation de Laine-Karras : brouillage d'Owen des bits de poids faible vers les forts
+    static uint32_t LaineKarrasPermutation(uint32_t x, const uint32_t seed) noexcept {
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return x;
+    }
+
+    static uint32_t NestedUniformScramble(const uint32_t x, const uint32_t seed) noexcept {
+        return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+    }
+
+    // Deux premieres dimensions de Sobol : van der Corput, puis les nombres directeurs v_i = v_{i-1} ^ (v_{i-1} >> 1)
+    static std::pair<uint32_t, uint32_t> Sobol2D(uint32_t index) noexcept {
+        const uint32_t first = ReverseBits(index);
+        uint32_t second = 0;
+        for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1) {
+            if (index & 1u) {
+                second ^= v;
+            }
+        }
+        return { first, second };
+    }
+
+    // Permutation de [0, length) indexee par seed (Kensler, "Correlated Multi-Jittered Sampling")
+    static uint32_t Permute(uint32_t i, const uint32_t length, const uint32_t seed) noexcept {
+        uint32_t w = length - 1;
+        w |= w >> 1;
+        w |= w >> 2;
+        w |= w >> 4;
+        w |= w >> 8;
+        w |= w >> 16;
+        do {
+            i ^= seed;
+            i *= 0xe170893du;
+            i ^= seed >> 16;
+            i ^= (i & w) >> 4;
+            i ^= seed >> 8;
+            i *= 0x0929eb3fu;
+            i ^= seed >> 23;
+            i ^= (i & w) >> 1;
+            i *= 1u | seed >> 27;
+            i *= 0x6935fa69u;
+            i ^= (i & w) >> 11;
+            i *= 0x74dcb303u;
+            i ^= (i & w) >> 2;
+            i *= 0x9e501cc3u;
+            i ^= (i & w) >> 2;
+            i *= 0xc860a3dfu;
+            i &= w;
+            i ^= i >> 5;
+        } while (i >= length);
+        return (i + seed) % length;
+    }
+
+public:
+    SamplerType Type() const noexcept { return type; }
+    void SetType(const SamplerType value) noexcept { type = value; }
+    void SetSeed(const uint32_t seed) noexcept { counter.SetSeed(seed); }
+
+    template <typename T>
+    T Uniform(const uint32_t pixel, const uint32_t sampleIndex, const uint32_t dimension, const uint64_t path = 0) const noexcept {
+        return counter.Uniform<T>(pixel, sampleIndex, dimension, path);
+    }
+
+    // Point de [0, 1)^2 de l'echantillon sampleIndex du pixel pour la dimension 2D donnee.
+    // sampleCount est le nombre d'echantillons prevu par pixel (taille de la grille stratifiee).
+    template <typename T>
+    std::pair<T, T> Sample2D(const uint32_t pixelX, const uint32_t pixelY, const uint32_t pixel, const uint32_t sampleIndex,
+        const uint32_t sampleCount, const uint32_t dimension) const noexcept {
+        switch (type) {
+            case SamplerType::STRATIFIED: {
+                const uint32_t side = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(sampleCount)))));
+                const uint32_t strata = side * side;
+                // chaque passage de strata echantillons utilise un nouvel ordre
+                const uint32_t stratum = Permute(sampleIndex % strata, strata, CounterSampler::PcgHash(counter.Hash(pixel, sampleIndex / strata, HASH_DIMENSION_2D + dimension * 2) ^ 0x5bd1e995u));
+                const T jitterX = counter.Uniform<T>(pixel, sampleIndex, HASH_DIMENSION_2D + dimension * 2);
+                const T jitterY = counter.Uniform<T>(pixel, sampleIndex, HASH_DIMENSION_2D + dimension * 2 + 1);
+                return { (static_cast<T>(stratum % side) + jitterX) / static_cast<T>(side),
+                    (static_cast<T>(stratum / side) + jitterY) / static_cast<T>(side) };
+            }
+            case SamplerType::SOBOL: {
+                const uint32_t seed = counter.Hash(pixel, 0, HASH_DIMENSION_2D + dimension * 2);
+                const uint32_t index = NestedUniformScramble(sampleIndex, seed);
+                const auto [x, y] = Sobol2D(index);
+                return { CounterSampler::ToUnit<T>(NestedUniformScramble(x, CounterSampler::PcgHash(seed ^ 0x68bc21ebu))),
+                    CounterSampler::ToUnit<T>(NestedUniformScramble(y, CounterSampler::PcgHash(seed ^ 0x02e5be93u))) };
+            }
+            case SamplerType::BLUE_NOISE: {
+                // suite R2 de Roberts, chaque dimension lit le masque a un autre decalage
+                constexpr double ALPHA_X = 0.7548776662466927;
+                constexpr double ALPHA_Y = 0.5698402909980532;
+                const BlueNoiseMask& mask = BlueNoiseMask::Get();
+                const uint32_t offset = dimension * 23;
+                const double shiftX = mask.Value(pixelX + offset, pixelY + offset);
+                const double shiftY = mask.Value(pixelX + offset + BlueNoiseMask::SIZE / 2, pixelY + offset + 11);
+                const double x = 0.5 + ALPHA_X * sampleIndex + shiftX;
+                const double y = 0.5 + ALPHA_Y * sampleIndex + shiftY;
+                return { std::min(static_cast<T>(x - std::floor(x)), T(1) - std::numeric_limits<T>::epsilon()),
+                    std::min(static_cast<T>(y - std::floor(y)), T(1) - std::numeric_limits<T>::epsilon()) };
+            }
+            case SamplerType::RANDOM:
+            default:
+                return { counter.Uniform<T>(pixel, sampleIndex, HASH_DIMENSION_2D + dimension * 2), counter.Uniform<T>(pixel, sampleIndex, HASH_DIMENSION_2D + dimension * 2 + 1) };
+        }
+    }
+};
@@ -1,15 +1,23 @@
 ﻿#pragma once
 
 #include <vector>
+#include <array>
+#include <span>
 #include "Shape.h"
 #include "Light.h"
+#include "BVH.h"
+#include "TileScheduler.h"
+#include "Stats.h"
+#include "Trace.h"
 #include <algorithm>
 #include <iostream>
 #include <ranges>
+#include <numeric>
 
-#ifdef _OPENMP
-#include <omp.h>
-#endif
+enum class RenderMode {
+    TILED,     // tuiles, chaque echantillon suit son chemin en profondeur
+    WAVEFRONT, // tous les rayons d'un meme rebond sont traites ensemble, etape par etape
+};
 
 class Scene {
 private:
@@ -19,22 +27,112 @@ private:
 	std::vector<Triangle> triangles;
 	std::vector<Model> models;
     std::vector<Light> lights;
+    std::vector<Material> materials{ Material() }; // indexed by MaterialId, 0 is the default material
+
+    // Top-level acceleration structure over every bounded primitive,
+    // infinite planes are kept out of it and tested linearly.
+    struct PrimitiveRef {
+        HitType type;
+        uint32_t index;
+        bool opaque; // aucune transparence, un hit suffit a bloquer une ombre
+    };
+    std::vector<PrimitiveRef> primitiveRefs;
+    std::vector<char> planeOpaque;
+    BVH sceneBVH;
+    // Loose triangles in world space, grouped by opacity so that a single transparent triangle does not
+    // send every shadow ray hitting an opaque one to the ordered walk. One TRIANGLE entry of the scene BVH per group.
+    struct TriangleGroup {
+        Mesh mesh;
+        std::vector<uint32_t> triangleIndices; // index in triangles of each mesh triangle
+    };
+    std::vector<TriangleGroup> triangleGroups;
+    bool accelerationDirty = true;
 
     Camera camera;
     int maxRecursion = 10;
-
-    static double fresnel(const double cosTheta, const double F0) {
-        return F0 + (1.0 - F0) * std::pow(1.0 - cosTheta, 5.0);
+    int russianRouletteDepth = 4; // profondeur a partir de laquelle les branches passent a la roulette russe
+    Real minPathWeight = Real(1e-3); // poids sous lequel une branche est abandonnee
+
+    uint32_t tileSize = 16;
+    TileOrder tileOrder = TileOrder::MORTON;
+    bool packetTracing = true; // rayons primaires tires par paquets de 8x8
+    RenderMode renderMode = RenderMode::TILED;
+    std::function<void(size_t, size_t)> progressCallback;
+    bool recordCost = false;
+    std::vector<PixelCost> costMap; // rempli par RenderImage quand recordCost est actif
+
+    static Real fresnel(const Real cosTheta, const Real F0) {
+        return F0 + (Real(1) - F0) * std::pow(Real(1) - cosTheta, Real(5));
     }
 
     Vec3 backgroundColor(const Rayon& ray) const {
-        double t = 0.5 * (ray.direction.normalize().y + 1.0);
-        return Vec3(1.0, 1.0, 1.0) * (1.0 - t) + Vec3(0.5, 0.7, 1.0) * t;
+        Real t = Real(0.5) * (ray.direction.normalize().y + Real(1));
+        return Vec3(1, 1, 1) * (Real(1) - t) + Vec3(Real(0.5), Real(0.7), Real(1)) * t;
     }
 
-    double computeTransmittance(const Rayon& ray, const double maxDist, const double bias) const {
-        double T = 1.0;
-        double traveled = 0.0;
+public:
+    enum class ShadowResult {
+        CLEAR,
+        OCCLUDED,
+        TRANSPARENT_HIT, // seuls des occultants transparents ont ete touches
+    };
+
+    // Requete d'ombre sans ordre ni HitInfo : s'arrete au premier occultant opaque dans ]minDist, maxDist[
+    // et signale seulement si un occultant transparent a ete croise. Comme la marche ordonnee, les
+    // primitives touchees a moins de minDist sont ignorees (coins ou se rejoignent deux plans).
+    ShadowResult QueryShadow(const Rayon& ray, const Real minDist, const Real maxDist) const {
+        auto within = [&](const std::optional<Real>& distOpt) { return distOpt && *distOpt > minDist && *distOpt < maxDist; };
+        bool transparentHit = false;
+
+        for (size_t i = 0; i < planes.size(); ++i) {
+            if (within(planes[i].Intersect(ray))) {
+                if (planeOpaque[i]) {
+                    return ShadowResult::OCCLUDED;
+                }
+                transparentHit = true;
+            }
+        }
+
+        const bool occluded = sceneBVH.TraverseAny(ray, maxDist, [&](const uint32_t refIndex) {
+            const PrimitiveRef& ref = primitiveRefs[refIndex];
+            // un occultant transparent deja vu rend inutile de tester les suivants
+            if (!ref.opaque && transparentHit) {
+                return false;
+            }
+            bool hit = false;
+            switch (ref.type) {
+                case HitType::SPHERE: hit = within(spheres[ref.index].Intersect(ray)); break;
+                case HitType::TRIANGLE: hit = triangleGroups[ref.index].mesh.IntersectAnyBefore(ray, maxDist, minDist); break;
+                case HitType::MODEL: hit = models[ref.index].IntersectAnyBefore(ray, maxDist, minDist); break;
+                default: break;
+            }
+            if (hit && !ref.opaque) {
+                transparentHit = true;
+                return false;
+            }
+            return hit;
+        });
+
+        if (occluded) {
+            return ShadowResult::OCCLUDED;
+        }
+        return transparentHit ? ShadowResult::TRANSPARENT_HIT : ShadowResult::CLEAR;
+    }
+
+    // Fraction de lumiere qui atteint maxDist le long du rayon. Le cas courant (libre ou bloque par
+    // un opaque) est resolu par QueryShadow, les hits ne sont parcourus dans l'ordre qu'en presence
+    // d'occultants transparents.
+    Real computeTransmittance(const Rayon& ray, const Real maxDist, const Real bias) const {
+        const Stats::RayScope statsScope(RayKind::SHADOW);
+        Stats::CountRay(RayKind::SHADOW);
+        switch (QueryShadow(ray, bias, maxDist)) {
+            case ShadowResult::CLEAR: return 1.0;
+            case ShadowResult::OCCLUDED: return 0.0;
+            case ShadowResult::TRANSPARENT_HIT: break;
+        }
+
+        Real T = 1.0;
+        Real traveled = 0.0;
         Rayon r = ray;
         int safety = 64;
 
@@ -47,7 +145,7 @@ private:
             }
 
             const HitInfo& hit = *hitOpt;
-            const double t = hit.distance;
+            const Real t = hit.distance;
             if (t <= 0.0) {
                 r.origin = r.origin + r.direction * (bias);
                 traveled += bias;
@@ -65,19 +163,21 @@ private:
                 break;
             }
 
-            const double tr = std::clamp(hit.material.transparency, 0.0, 1.0);
+            const Real tr = std::clamp(materials[hit.materialId].transparency, Real(0), Real(1));
             T *= tr;
 
-            const Vec3 newOrigin = r.pointAtDistance(t) + r.direction * bias;
-            traveled += t + bias;
-            r.origin = newOrigin;
+            // continue from just behind the crossed surface
+            const Vec3 exitNormal = hit.normal.dot(r.direction) > Real(0) ? hit.normal : -hit.normal;
+            r.origin = OffsetRayOrigin(hit.hitPoint, exitNormal);
+            traveled += t;
         }
 
-        return std::clamp(T, 0.0, 1.0);
+        return std::clamp(T, Real(0), Real(1));
     }
 
-    Vec3 directLightning(const HitInfo& hit, const Vec3& viewDir, const Vec3& normalIn, const double bias) const {
-        const Material& material = hit.material;
+private:
+    Vec3 directLightning(const HitInfo& hit, const Vec3& viewDir, const Vec3& normalIn, const Real bias) const {
+        const Material& material = materials[hit.materialId];
         Vec3 normal = normalIn.normalize();
 
         auto diffuseAccumulation = Vec3{ 0,0,0 };
@@ -85,11 +185,11 @@ private:
 
         for (const auto& light : lights) {
             Vec3 vecToLight = light.position - hit.hitPoint;
-            const double distanceToLight = vecToLight.length();
+            const Real distanceToLight = vecToLight.length();
             if (distanceToLight <= 0.0) continue;
             Vec3 lightToHit = vecToLight / distanceToLight;
 
-            const double normalDotLightHit = std::max(0.0, normal.dot(lightToHit));
+            const Real normalDotLightHit = std::max(Real(0), normal.dot(lightToHit));
             if (normalDotLightHit <= 0.0)
             {
                 continue;
@@ -100,25 +200,25 @@ private:
                 continue;
             }
 
-            Rayon shadowRay{ hit.hitPoint + normal * bias, lightToHit };
-            const double transmittance = computeTransmittance(shadowRay, distanceToLight - bias, bias);
+            Rayon shadowRay{ OffsetRayOrigin(hit.hitPoint, normal), lightToHit };
+            const Real transmittance = computeTransmittance(shadowRay, distanceToLight - bias, bias);
             if (transmittance <= bias)
             {
                 continue;
             }
 
             Vec3 emitted = light.color * light.intensity;
-            Vec3 contribution = emitted * (1.0 / (distanceToLight * distanceToLight)) * normalDotLightHit;
+            Vec3 contribution = emitted * (Real(1) / (distanceToLight * distanceToLight)) * normalDotLightHit;
 
             diffuseAccumulation += contribution * transmittance;
 
             if (material.transparency <= 0.0 && material.specular > 0.0) {
                 Vec3 halfVector = (lightToHit + viewDir).normalize();
-                double NdotH = std::max(0.0, normal.dot(halfVector));
+                Real NdotH = std::max(Real(0), normal.dot(halfVector));
                 if (NdotH > 0.0) {
-                    const double specFactor = std::pow(NdotH, material.shininess);
+                    const Real specFactor = std::pow(NdotH, material.shininess);
                     // speculaire pondéré par la même attenuation et transmittance
-                    specularAccumlation += (emitted * (1.0 / (distanceToLight * distanceToLight))) * specFactor * transmittance;
+                    specularAccumlation += (emitted * (Real(1) / (distanceToLight * distanceToLight))) * specFactor * transmittance;
                 }
             }
         }
@@ -128,74 +228,366 @@ private:
         return diffuse + specular;
     }
 
-    std::optional<Vec3> TraceRay(const Rayon& traceRay, int recursionAmount, const double bias) const {
-        if (recursionAmount >= maxRecursion) {
-			return backgroundColor(traceRay); // ciel
+    // Rayon en attente dans la pile du chemin, avec le poids qu'il apporte au pixel
+    struct PathVertex {
+        Rayon ray{ Vec3(0, 0, 0), Vec3(0, 0, 1) };
+        Real throughput = 0;
+        int depth = 0;
+        uint64_t pathId = 1; // 1 pour le rayon primaire, 2 * id + branche (0 refraction, 1 reflexion) pour ses rebonds
+    };
+    static constexpr int PATH_STACK_SIZE = 64;
+
+    static RayKind PathRayKind(const PathVertex& vertex) {
+        if (vertex.depth == 0) {
+            return RayKind::PRIMARY;
+        }
+        return (vertex.pathId & 1) ? RayKind::REFLECTION : RayKind::REFRACTION;
+    }
+
+    // Echantillon en cours, cle des nombres aleatoires du chemin avec pathId
+    struct SampleContext {
+        uint32_t pixel;
+        uint32_t sample;
+    };
+
+    // Filtre une branche avant de l'empiler : coupe les poids negligeables puis, passe
+    // russianRouletteDepth, la garde avec une probabilite egale a son poids et la compense.
+    // Le tirage ne depend que de (pixel, echantillon, pathId) : meme decision quel que soit le mode de rendu.
+    bool keepBranch(PathVertex& branch, const SampleContext& context) const {
+        if (branch.throughput < minPathWeight) {
+            return false;
+        }
+        if (branch.depth >= russianRouletteDepth && branch.depth < maxRecursion && branch.throughput < Real(1)) {
+            const Real survival = std::max(branch.throughput, Real(0.05));
+            if (camera.sampler.Uniform<Real>(context.pixel, context.sample, SAMPLE_ROULETTE, branch.pathId) >= survival) {
+                return false;
+            }
+            branch.throughput /= survival;
         }
+        return true;
+    }
 
-        const auto hitOpt = IntersectClosest(traceRay);
-        if (!hitOpt) {
-            return backgroundColor(traceRay);
+    // Integrateur iteratif : chaque rayon est evalue une fois et pousse au plus deux
+    // branches (refraction, reflexion) ponderees, le travail par echantillon est borne
+    // par la taille de la pile et non plus par 2^maxRecursion
+    Vec3 TraceRay(const Rayon& primaryRay, const Real bias, const SampleContext& context) const {
+        return TraceRay(primaryRay, bias, IntersectClosest(primaryRay), context);
+    }
+
+    // Meme chose avec l'intersection du rayon primaire deja calculee (paquets de rayons primaires)
+    Vec3 TraceRay(const Rayon& primaryRay, const Real bias, const std::optional<HitInfo>& primaryHit, const SampleContext& context) const {
+        std::array<PathVertex, PATH_STACK_SIZE> stack;
+        int stackSize = 0;
+        stack[stackSize++] = { primaryRay, Real(1), 0, 1 };
+
+        Vec3 radiance{ 0, 0, 0 };
+        while (stackSize > 0) {
+            const PathVertex vertex = stack[--stackSize];
+
+            std::optional<HitInfo> hitOpt;
+            if (vertex.depth < maxRecursion) {
+                const Stats::RayScope statsScope(PathRayKind(vertex));
+                Stats::CountRay(PathRayKind(vertex));
+                hitOpt = vertex.depth == 0 ? primaryHit : IntersectClosest(vertex.ray);
+            }
+            int kept = 0;
+            radiance += ShadeVertex(vertex, hitOpt, bias, [&](PathVertex branch) {
+                if (stackSize < PATH_STACK_SIZE && keepBranch(branch, context)) {
+                    stack[stackSize++] = branch;
+                    ++kept;
+                }
+            });
+            if (kept == 0) {
+                Stats::CountPathEnd(vertex.depth);
+            }
         }
 
-        const HitInfo hit = hitOpt.value();
-        const Material& material = hit.material;
+        return radiance;
+    }
+
+    // Evalue un sommet du chemin a partir de son intersection : renvoie la lumiere qu'il apporte
+    // (ponderee par son poids) et appelle spawn(branche) pour la refraction et la reflexion.
+    // Partage par TraceRay et le mode wavefront.
+    template <typename SpawnFn>
+    Vec3 ShadeVertex(const PathVertex& vertex, const std::optional<HitInfo>& hitOpt, const Real bias, SpawnFn&& spawn) const {
+        const Rayon& traceRay = vertex.ray;
+        if (vertex.depth >= maxRecursion || !hitOpt) {
+            return backgroundColor(traceRay) * vertex.throughput; // ciel
+        }
+
+        const HitInfo& hit = hitOpt.value();
+        const Material& material = materials[hit.materialId];
 
         const Vec3 incoming = traceRay.direction.normalize();
         const bool frontFace = hit.normal.dot(incoming) < 0.0;
         const Vec3 normal = frontFace ? hit.normal : -hit.normal;
         const Vec3 viewDir = -incoming;
-        const double cosTheta = std::max(0.0, normal.dot(viewDir));
+        const Real cosTheta = std::max(Real(0), normal.dot(viewDir));
 
         static constexpr bool visualizeNormals = false;
         if (visualizeNormals) {
             if (!std::isfinite(hit.distance) ||
                 !std::isfinite(hit.normal.x) || !std::isfinite(hit.normal.y) || !std::isfinite(hit.normal.z)) {
-                return Vec3(1.0, 0.0, 1.0); // magenta = hit invalide
+                return Vec3(1.0, 0.0, 1.0) * vertex.throughput; // magenta = hit invalide
             }
             Vec3 n = normal.normalize();
             // mapping standard pour debug normals
-            return Vec3((n.x * 0.5) + 0.5, (n.y * 0.5) + 0.5, (n.z * 0.5) + 0.5);
+            return Vec3((n.x * Real(0.5)) + Real(0.5), (n.y * Real(0.5)) + Real(0.5), (n.z * Real(0.5)) + Real(0.5)) * vertex.throughput;
         }
 
-        constexpr double etaI = 1.0;
-        const double etaT = material.refractiveIndex;
-        const double f0 = std::pow((etaT - etaI) / (etaT + etaI), 2.0);
-        double fresnelAmount = fresnel(cosTheta, f0);
+        constexpr Real etaI = 1.0;
+        const Real etaT = material.refractiveIndex;
+        const Real f0 = std::pow((etaT - etaI) / (etaT + etaI), Real(2));
+        Real fresnelAmount = fresnel(cosTheta, f0);
 
-        double transparency = std::clamp(material.transparency, 0.0, 1.0);
-
-        Vec3 localLight = directLightning(hit, viewDir, normal, bias);
-        Vec3 finalLight{0,0,0};
+        Real transparency = std::clamp(material.transparency, Real(0), Real(1));
 
+        Vec3 radiance{ 0, 0, 0 };
         if (transparency < 1.0) {
-            finalLight += localLight * (1.0 - transparency);
+            radiance = directLightning(hit, viewDir, normal, bias) * ((Real(1) - transparency) * vertex.throughput);
         }
 
         if (transparency > 0.0) {
-            const double eta = frontFace ? (etaI / etaT) : (etaT / etaI);
+            const Real eta = frontFace ? (etaI / etaT) : (etaT / etaI);
 
             if (auto refractDir = incoming.refract(normal, eta); refractDir.length() > bias) {
                 refractDir = refractDir.normalize();
-                Rayon refractRay{ hit.hitPoint + refractDir * (bias * 1e2), refractDir };
-                if (auto tc = TraceRay(refractRay, recursionAmount + 1, bias)) {
-                    finalLight += tc.value() * (transparency * (1.0 - fresnelAmount));
-                }
+                spawn(PathVertex{ Rayon{ OffsetRayOrigin(hit.hitPoint, -normal), refractDir },
+                    vertex.throughput * transparency * (Real(1) - fresnelAmount), vertex.depth + 1, vertex.pathId * 2 });
             } else {
-				fresnelAmount = 1.0;
+                fresnelAmount = 1.0;
             }
         }
 
-    	if (auto reflectiveness = (transparency > 0.0) ? fresnelAmount : material.specular; reflectiveness > bias) {
+        if (auto reflectiveness = (transparency > 0.0) ? fresnelAmount : material.specular; reflectiveness > bias) {
             Vec3 reflectDir = incoming.reflect(normal).normalize();
-            Rayon reflectRay{ hit.hitPoint + reflectDir * bias, reflectDir };
-            if (auto rc = TraceRay(reflectRay, recursionAmount + 1, bias)) {
-                finalLight += rc.value() * reflectiveness;
+            spawn(PathVertex{ Rayon{ OffsetRayOrigin(hit.hitPoint, normal), reflectDir },
+                vertex.throughput * reflectiveness, vertex.depth + 1, vertex.pathId * 2 + 1 });
+        }
+
+        return radiance;
+    }
+
+    struct WavefrontRay {
+        PathVertex vertex;
+        uint32_t pixel = 0;
+    };
+
+    // Cle de tri d'un rayon : octant de sa direction puis cellule de son origine (Morton 3 x 10 bits)
+    static uint64_t WavefrontSortKey(const Rayon& ray, const AABB& bounds) {
+        const auto spread = [](uint64_t v) {
+            v &= 0x3ff;
+            v = (v | (v << 16)) & 0x30000ff;
+            v = (v | (v << 8)) & 0x300f00f;
+            v = (v | (v << 4)) & 0x30c30c3;
+            v = (v | (v << 2)) & 0x9249249;
+            return v;
+        };
+        const auto cell = [](const Real p, const Real lo, const Real hi) {
+            const Real t = hi > lo ? (p - lo) / (hi - lo) : Real(0);
+            return static_cast<uint64_t>(std::clamp(t, Real(0), Real(1)) * Real(1023));
+        };
+        const uint64_t octant = (ray.direction.x < 0 ? 1u : 0u) | (ray.direction.y < 0 ? 2u : 0u) | (ray.direction.z < 0 ? 4u : 0u);
+        const uint64_t morton = spread(cell(ray.origin.x, bounds.min.x, bounds.max.x))
+            | (spread(cell(ray.origin.y, bounds.min.y, bounds.max.y)) << 1)
+            | (spread(cell(ray.origin.z, bounds.min.z, bounds.max.z)) << 2);
+        return (octant << 30) | morton;
+    }
+
+    // Tri des cles de WavefrontSortKey (33 bits) par base, chiffres de poids faible d'abord, reparti sur le
+    // pool : chaque bloc compte ses chiffres, un prefixe sur chiffres x blocs donne la position de depart
+    // de chaque bloc, puis chaque bloc disperse ses elements. Stable et parti d'indices croissants, il
+    // donne le meme ordre que std::sort sur les paires, qui reste utilise pour les petites vagues.
+    static void SortWavefrontKeys(std::vector<std::pair<uint64_t, uint32_t>>& keys, std::vector<std::pair<uint64_t, uint32_t>>& scratch, ThreadPool& pool) {
+        constexpr int DIGIT_BITS = 11;
+        constexpr int PASSES = 3;
+        constexpr size_t BUCKETS = size_t(1) << DIGIT_BITS;
+        constexpr size_t BLOCK = size_t(1) << 14;
+        const size_t count = keys.size();
+        if (count < BLOCK * 2) {
+            std::sort(keys.begin(), keys.end());
+            return;
+        }
+
+        const size_t blockCount = (count + BLOCK - 1) / BLOCK;
+        std::vector<uint32_t> offsets(blockCount * BUCKETS);
+        scratch.resize(count);
+        for (int pass = 0; pass < PASSES; ++pass) {
+            const int shift = pass * DIGIT_BITS;
+            const auto digit = [shift](const uint64_t key) { return static_cast<size_t>((key >> shift) & (BUCKETS - 1)); };
+
+            pool.ParallelFor(0, blockCount, 1, [&](const size_t firstBlock, const size_t lastBlock) {
+                for (size_t block = firstBlock; block < lastBlock; ++block) {
+                    uint32_t* histogram = offsets.data() + block * BUCKETS;
+                    std::fill(histogram, histogram + BUCKETS, 0u);
+                    for (size_t i = block * BLOCK; i < std::min(count, (block + 1) * BLOCK); ++i) {
+                        ++histogram[digit(keys[i].first)];
+                    }
+                }
+            });
+            uint32_t position = 0;
+            for (size_t d = 0; d < BUCKETS; ++d) {
+                for (size_t block = 0; block < blockCount; ++block) {
+                    uint32_t& slot = offsets[block * BUCKETS + d];
+                    const uint32_t size = slot;
+                    slot = position;
+                    position += size;
+                }
+            }
+            pool.ParallelFor(0, blockCount, 1, [&](const size_t firstBlock, const size_t lastBlock) {
+                for (size_t block = firstBlock; block < lastBlock; ++block) {
+                    uint32_t* next = offsets.data() + block * BUCKETS;
+                    for (size_t i = block * BLOCK; i < std::min(count, (block + 1) * BLOCK); ++i) {
+                        scratch[next[digit(keys[i].first)]++] = keys[i];
+                    }
+                }
+            });
+            keys.swap(scratch);
+        }
+    }
+
+    // Rendu par vagues : a chaque tour d'echantillonnage, les rayons de tous les pixels actifs passent
+    // ensemble par les etapes generation, tri, intersection, shading et emission des rebonds. Le tri par
+    // octant puis cellule d'origine rend coherents les acces memoire des etapes d'intersection et de shading.
+    // Meme integrateur que TraceRay (ShadeVertex, keepBranch), seul l'ordre des calculs change.
+    std::vector<Vec3> RenderWavefront(const std::span<PixelCost> costs) const {
+        constexpr Real bias = Real(1e-3);
+        const int minSamples = std::max(1, camera.minSamples);
+        const int maxSamples = camera.SampleCount();
+        const size_t width = camera.width;
+        const size_t pixelCount = camera.width * camera.height;
+        ThreadPool& pool = ThreadPool::Global();
+        constexpr size_t GRAIN = 1024;
+
+        AABB sortBounds = sceneBVH.Bounds();
+        sortBounds.expand(camera.position);
+
+        std::vector<PixelEstimate> estimates(pixelCount);
+        std::vector<Vec3> sampleRadiance(pixelCount, Vec3(0, 0, 0));
+        std::vector<uint32_t> active(pixelCount);
+        std::iota(active.begin(), active.end(), 0u);
+
+        std::vector<WavefrontRay> queue, next;
+        std::vector<std::pair<uint64_t, uint32_t>> keys, sortScratch;
+        std::vector<std::optional<HitInfo>> hits;
+        std::vector<Vec3> contributions;
+        std::vector<WavefrontRay> spawned;
+        std::vector<uint8_t> spawnCount;
+        std::vector<PixelCost> rayCosts; // cout de chaque rayon de la vague, reporte sur son pixel a l'emission
+        const bool recordCosts = !costs.empty();
+
+        for (uint32_t sample = 0; sample < static_cast<uint32_t>(maxSamples) && !active.empty(); ++sample) {
+            // generation
+            queue.resize(active.size());
+            pool.ParallelFor(0, active.size(), GRAIN, [&](const size_t begin, const size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    const uint32_t pixel = active[i];
+                    queue[i] = { { camera.getRay(pixel % width, pixel / width, sample, static_cast<uint32_t>(maxSamples)), Real(1), 0, 1 }, pixel };
+                    sampleRadiance[pixel] = Vec3(0, 0, 0);
+                }
+            });
+
+            while (!queue.empty()) {
+                const size_t count = queue.size();
+                TRACE_SCOPE("wave", "render", "sample", sample, "rays", static_cast<int64_t>(count));
+
+                // tri
+                {
+                    TRACE_SCOPE("sort");
+                    keys.resize(count);
+                    pool.ParallelFor(0, count, GRAIN, [&](const size_t begin, const size_t end) {
+                        for (size_t i = begin; i < end; ++i) {
+                            keys[i] = { WavefrontSortKey(queue[i].vertex.ray, sortBounds), static_cast<uint32_t>(i) };
+                        }
+                    });
+                    SortWavefrontKeys(keys, sortScratch, pool);
+                    next.resize(count);
+                    for (size_t i = 0; i < count; ++i) {
+                        next[i] = queue[keys[i].second];
+                    }
+                    std::swap(queue, next);
+                }
+
+                // intersection
+                hits.resize(count);
+                if (recordCosts) {
+                    rayCosts.assign(count, PixelCost{});
+                }
+                pool.ParallelFor(0, count, GRAIN, [&](const size_t begin, const size_t end) {
+                    TRACE_SCOPE("intersection", "render", "begin", static_cast<int64_t>(begin));
+                    for (size_t i = begin; i < end; ++i) {
+                        const PathVertex& vertex = queue[i].vertex;
+                        const CostSample costBegin = recordCosts ? Stats::Sample() : CostSample{};
+                        if (vertex.depth < maxRecursion) {
+                            const Stats::RayScope statsScope(PathRayKind(vertex));
+                            Stats::CountRay(PathRayKind(vertex));
+                            hits[i] = IntersectClosest(vertex.ray);
+                        } else {
+                            hits[i] = std::nullopt;
+                        }
+                        if (recordCosts) {
+                            rayCosts[i].Add(costBegin, Stats::Sample());
+                        }
+                    }
+                });
+
+                // shading, chaque rayon emet au plus deux rebonds dans ses propres cases
+                contributions.resize(count);
+                spawned.resize(count * 2);
+                spawnCount.assign(count, 0);
+                pool.ParallelFor(0, count, GRAIN, [&](const size_t begin, const size_t end) {
+                    TRACE_SCOPE("shading", "render", "begin", static_cast<int64_t>(begin));
+                    for (size_t i = begin; i < end; ++i) {
+                        const WavefrontRay& current = queue[i];
+                        const SampleContext context{ current.pixel, sample };
+                        const CostSample costBegin = recordCosts ? Stats::Sample() : CostSample{};
+                        contributions[i] = ShadeVertex(current.vertex, hits[i], bias, [&](PathVertex branch) {
+                            if (keepBranch(branch, context)) {
+                                spawned[i * 2 + spawnCount[i]++] = { branch, current.pixel };
+                            }
+                        });
+                        if (spawnCount[i] == 0) {
+                            Stats::CountPathEnd(current.vertex.depth);
+                        }
+                        if (recordCosts) {
+                            rayCosts[i].Add(costBegin, Stats::Sample());
+                        }
+                    }
+                });
+
+                // emission : accumulation par pixel et compaction des rebonds pour la vague suivante
+                TRACE_SCOPE("emission");
+                next.clear();
+                for (size_t i = 0; i < count; ++i) {
+                    sampleRadiance[queue[i].pixel] += contributions[i];
+                    if (recordCosts) {
+                        costs[queue[i].pixel] += rayCosts[i];
+                    }
+                    for (uint8_t k = 0; k < spawnCount[i]; ++k) {
+                        next.push_back(spawned[i * 2 + k]);
+                    }
+                }
+                std::swap(queue, next);
             }
+
+            pool.ParallelFor(0, active.size(), GRAIN, [&](const size_t begin, const size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    estimates[active[i]].Add(sampleRadiance[active[i]]);
+                }
+            });
+            std::erase_if(active, [&](const uint32_t pixel) {
+                const PixelEstimate& estimate = estimates[pixel];
+                return estimate.samples >= minSamples && estimate.Converged(camera.sampleErrorThreshold);
+            });
         }
 
-        return finalLight;
+        std::vector<Vec3> finalImage(pixelCount);
+        for (size_t i = 0; i < pixelCount; ++i) {
+            finalImage[i] = estimates[i].meanColor;
+        }
+        return finalImage;
     }
+
 public:
     explicit Scene(const Camera& camera) : camera(camera) {
         const size_t pixelCount = camera.width * camera.height;
@@ -205,125 +597,369 @@ public:
 		this->triangles = std::vector<Triangle>();
     }
 
-    void AddSphere(Sphere& sphere) { spheres.emplace_back(sphere); }
-    void AddPlane(Plane& plane) { planes.emplace_back(plane); }
+    // Stores the material once and returns its index for the primitives using it,
+    // an identical material already in the table is reused
+    MaterialId AddMaterial(const Material& material) {
+        if (const auto found = std::ranges::find(materials, material); found != materials.end()) {
+            return static_cast<MaterialId>(found - materials.begin());
+        }
+        materials.push_back(material);
+        return static_cast<MaterialId>(materials.size() - 1);
+    }
+    const Material& GetMaterial(const MaterialId id) const { return materials.at(id); }
+
+    void AddSphere(Sphere& sphere) { spheres.emplace_back(sphere); accelerationDirty = true; }
+    void AddPlane(Plane& plane) { planes.emplace_back(plane); accelerationDirty = true; }
     void AddLight(Light& light) { lights.emplace_back(light); }
-	void AddTriangle(Triangle& triangle) { triangles.emplace_back(triangle); }
-	void AddModel(Model& model) { models.emplace_back(model); }
+	void AddTriangle(Triangle& triangle) { triangles.emplace_back(triangle); accelerationDirty = true; }
+	void AddModel(Model& model) { models.emplace_back(model); accelerationDirty = true; }
 
-    size_t GetPixelIndex(const size_t x, const size_t y) const {
-        return y * camera.width + x;
+    // Moving an instance only touches the top-level structure, the mesh BVH is shared and left intact
+    void SetModelTransform(const size_t modelIndex, const Transform& transform) {
+        models[modelIndex].SetTransform(transform);
+        accelerationDirty = true;
     }
 
-    std::optional<HitInfo> IntersectClosest(const Rayon& ray) const {
-        std::optional<HitInfo> closest = std::nullopt;
+    // Limites de l'integrateur : profondeur max, debut de la roulette russe (>= maxDepth la desactive)
+    // et poids minimal d'une branche. La pile etant parcourue en profondeur, elle contient au plus
+    // maxDepth + 1 rayons, la profondeur est donc bornee par sa taille.
+    void SetPathLimits(const int maxDepth, const int rouletteDepth, const Real minWeight) {
+        maxRecursion = std::clamp(maxDepth, 1, PATH_STACK_SIZE - 1);
+        russianRouletteDepth = std::max(rouletteDepth, 0);
+        minPathWeight = std::max(minWeight, Real(0));
+    }
 
-        for (size_t sphereIndex = 0; sphereIndex < spheres.size(); ++sphereIndex) {
-            if (auto hitOpt = spheres[sphereIndex].GetHitInfoAt(ray, sphereIndex); hitOpt) {
-                if (HitInfo hit = hitOpt.value(); !closest.has_value() || hit.isCloserThan(closest.value())) {
-                    closest = hit;
+    // Taille (en pixels) et ordre des tuiles distribuees au pool de threads
+    void SetTileOptions(const uint32_t size, const TileOrder order) {
+        tileSize = std::max<uint32_t>(size, 1);
+        tileOrder = order;
+    }
+
+    void SetPacketTracing(const bool enabled) { packetTracing = enabled; }
+    void SetRenderMode(const RenderMode mode) { renderMode = mode; }
+
+    // Mesure par pixel du temps (cycles), des rayons et des tests d'intersection pendant RenderImage.
+    // Les rayons et tests viennent des totaux par thread de Stats, comptes meme sans RAYTRACING_STATS.
+    void SetCostMap(const bool enabled) { recordCost = enabled; }
+    const std::vector<PixelCost>& GetCostMap() const { return costMap; }
+
+    // Appele apres chaque tuile avec (tuiles terminees, total), depuis le thread de rendu
+    void SetProgressCallback(std::function<void(size_t, size_t)> callback) {
+        progressCallback = std::move(callback);
+    }
+
+    // Must be called once the scene is filled and before any intersection query,
+    // RenderImage does it automatically when primitives were added since the last build.
+    void BuildAccelerationStructure() {
+        TRACE_SCOPE("BuildAccelerationStructure", "build");
+        primitiveRefs.clear();
+        primitiveRefs.reserve(spheres.size() + triangles.size() + models.size());
+        std::vector<AABB> bounds;
+        bounds.reserve(primitiveRefs.capacity());
+
+        for (size_t i = 0; i < spheres.size(); ++i) {
+            primitiveRefs.push_back({ HitType::SPHERE, static_cast<uint32_t>(i), GetMaterial(spheres[i].getMaterialId()).transparency <= 0.0 });
+            bounds.push_back(spheres[i].GetBounds());
+        }
+        triangleGroups.clear();
+        for (const bool opaque : { true, false }) {
+            std::vector<uint32_t> members;
+            for (uint32_t i = 0; i < triangles.size(); ++i) {
+                if ((GetMaterial(triangles[i].GetMaterialId()).transparency <= 0.0) == opaque) {
+                    members.push_back(i);
                 }
             }
+            if (members.empty()) {
+                continue;
+            }
+            std::vector<int> indices(members.size() * 3);
+            std::vector<Vec3> positions;
+            positions.reserve(indices.size());
+            for (const uint32_t i : members) {
+                positions.push_back(triangles[i].tv0());
+                positions.push_back(triangles[i].tv1());
+                positions.push_back(triangles[i].tv2());
+            }
+            std::iota(indices.begin(), indices.end(), 0);
+            triangleGroups.push_back({ Mesh(std::move(indices), std::move(positions)), std::move(members) });
+            primitiveRefs.push_back({ HitType::TRIANGLE, static_cast<uint32_t>(triangleGroups.size() - 1), opaque });
+            bounds.push_back(triangleGroups.back().mesh.GetBounds());
+        }
+        for (size_t i = 0; i < models.size(); ++i) {
+            if (AABB modelBounds = models[i].GetBounds(); modelBounds.isValid()) {
+                primitiveRefs.push_back({ HitType::MODEL, static_cast<uint32_t>(i), GetMaterial(models[i].GetMaterialId()).transparency <= 0.0 });
+                bounds.push_back(modelBounds);
+            }
+        }
+
+        planeOpaque.resize(planes.size());
+        for (size_t i = 0; i < planes.size(); ++i) {
+            planeOpaque[i] = GetMaterial(planes[i].GetMaterialId()).transparency <= 0.0;
         }
 
+        sceneBVH.Build(bounds);
+        accelerationDirty = false;
+    }
+
+    size_t GetPixelIndex(const size_t x, const size_t y) const {
+        return y * camera.width + x;
+    }
+
+    // Closest hit among the infinite planes, tested linearly
+    void IntersectPlanes(const Rayon& ray, Real& tMax, std::optional<HitInfo>& closest) const {
         for (size_t planeIndex = 0; planeIndex < planes.size(); ++planeIndex) {
             if (auto hitOpt = planes[planeIndex].GetHitInfoAt(ray, planeIndex); hitOpt) {
                 if (HitInfo hit = hitOpt.value(); !closest.has_value() || hit.isCloserThan(closest.value())) {
                     closest = hit;
+                    tMax = hit.distance;
                 }
             }
         }
+    }
 
-        for (size_t triangleIndex = 0; triangleIndex < triangles.size(); ++triangleIndex) {
-            if (auto hitOpt = triangles[triangleIndex].GetHitInfoAt(ray, triangleIndex); hitOpt) {
-                if (HitInfo hit = hitOpt.value(); !closest.has_value() || hit.isCloserThan(closest.value())) {
-                    closest = hit;
+    // Tests one entry of the scene BVH, replaces closest and shrinks tMax on a nearer hit
+    bool IntersectPrimitive(const PrimitiveRef& ref, const Rayon& ray, Real& tMax, std::optional<HitInfo>& closest) const {
+        std::optional<HitInfo> hitOpt;
+        switch (ref.type) {
+            case HitType::SPHERE: hitOpt = spheres[ref.index].GetHitInfoAt(ray, ref.index); break;
+            case HitType::TRIANGLE: {
+                const TriangleGroup& group = triangleGroups[ref.index];
+                if (Real distance = tMax; auto meshIndex = group.mesh.IntersectClosest(ray, distance)) {
+                    const uint32_t triangleIndex = group.triangleIndices[meshIndex.value()];
+                    hitOpt = HitInfo{
+                        .type = HitType::TRIANGLE,
+                        .materialId = triangles[triangleIndex].GetMaterialId(),
+                        .distance = distance,
+                        .index = triangleIndex,
+                        .normal = group.mesh.GetNormal(meshIndex.value()),
+                        .hitPoint = ray.pointAtDistance(distance)
+                    };
                 }
+                break;
             }
+            case HitType::MODEL: hitOpt = models[ref.index].GetHitInfoAt(ray, ref.index, tMax); break;
+            default: break;
         }
 
-        for (int modelIndex = 0; modelIndex < models.size(); ++modelIndex)
-        {
-            if (auto hitOpt = models[modelIndex].GetHitInfoAt(ray, modelIndex); hitOpt)
-            {
-                
-                if (HitInfo hit = hitOpt.value(); !closest.has_value() || hit.isCloserThan(closest.value())) {
-                    closest = hit;
-                }
-            }
+        if (hitOpt && hitOpt->distance < tMax) {
+            closest = hitOpt;
+            tMax = hitOpt->distance;
+            return true;
         }
+        return false;
+    }
+
+    std::optional<HitInfo> IntersectClosest(const Rayon& ray) const {
+        std::optional<HitInfo> closest = std::nullopt;
+        Real closestDistance = std::numeric_limits<Real>::infinity();
+
+        IntersectPlanes(ray, closestDistance, closest);
+        sceneBVH.Traverse(ray, closestDistance, [&](const uint32_t refIndex, Real& tMax) {
+            return IntersectPrimitive(primitiveRefs[refIndex], ray, tMax, closest);
+        });
 
         return closest;
     }
 
-    bool IntersectAnyBefore(const Rayon& ray, const double maxDist) const {
-        if (spheres.empty() && planes.empty() && triangles.empty() && models.empty()) {
-            return false;
+    // Closest hit of every ray of a coherent packet (hits.size() == rays.size()). The scene BVH is
+    // walked once for the whole packet with interval culling, the primitives of the leaves it
+    // reaches are then tested ray by ray with their own tMax.
+    void IntersectPacket(const std::span<const Rayon> rays, const std::span<std::optional<HitInfo>> hits) const {
+        thread_local std::vector<Real> rayMax;
+        rayMax.assign(rays.size(), std::numeric_limits<Real>::infinity());
+
+        Real packetMax = 0;
+        for (size_t i = 0; i < rays.size(); ++i) {
+            hits[i].reset();
+            IntersectPlanes(rays[i], rayMax[i], hits[i]);
+            packetMax = std::max(packetMax, rayMax[i]);
         }
 
-        auto within = [&](const double d) { return d > 0.0 && d < maxDist; };
-
-        auto any_hit = [&](const auto& container) {
-            return std::ranges::any_of(container, [&](const auto& obj) {
-                if (auto distOpt = obj.Intersect(ray)) {
-                    return within(*distOpt);
-                }
-                return false;
-            });
-        };
-
-        return any_hit(spheres) || any_hit(planes) || any_hit(triangles) || any_hit(models);
+        const RayInterval interval(rays);
+        sceneBVH.TraversePacket(interval, packetMax, [&](const uint32_t refIndex, Real& tMax) {
+            const PrimitiveRef& ref = primitiveRefs[refIndex];
+            tMax = 0;
+            for (size_t i = 0; i < rays.size(); ++i) {
+                IntersectPrimitive(ref, rays[i], rayMax[i], hits[i]);
+                tMax = std::max(tMax, rayMax[i]);
+            }
+        });
     }
 
-    std::optional<HitInfo> CalculatePixelDepth(const size_t x, const size_t y, const bool aa) const {
-        const Rayon ray = camera.getRay(x, y, aa);
+    std::optional<HitInfo> CalculatePixelDepth(const size_t x, const size_t y, const uint32_t sampleIndex) const {
+        const Rayon ray = camera.getRay(x, y, sampleIndex, static_cast<uint32_t>(camera.SampleCount()));
         return IntersectClosest(ray);
     }
 
-    Vec3 GeneratePixelAt(const int x, const int y) const {
-        auto accumulatedColor = Vec3{ 0,0,0 };
+    // Moyenne et variance de la luminance d'un pixel, mises a jour avec l'algorithme de Welford
+    struct PixelEstimate {
+        Vec3 meanColor{ 0, 0, 0 };
+        Real meanLuminance = 0;
+        Real squaredDeviations = 0; // M2 de Welford
         int samples = 0;
 
-        const int aaCount = camera.antiAliasingAmount;
+        void Add(const Vec3& color) {
+            ++samples;
+            const Real inv = Real(1) / static_cast<Real>(samples);
+            meanColor += (color - meanColor) * inv;
+            const Real lum = Real(0.2126) * color.x + Real(0.7152) * color.y + Real(0.0722) * color.z;
+            const Real delta = lum - meanLuminance;
+            meanLuminance += delta * inv;
+            squaredDeviations += delta * (lum - meanLuminance);
+        }
 
-        for (int aa = 0; aa < aaCount; ++aa)
-        {
-	        constexpr double bias = 1e-3;
-	        if (auto color = GenerateAntiAliasing(x, y, aa > 0 && aaCount > 1, bias)) {
-                accumulatedColor += color.value();
-                samples += 1;
+        // Vrai quand l'intervalle de confiance a 95% de la luminance moyenne passe sous le seuil relatif
+        bool Converged(const Real errorThreshold) const {
+            if (samples < 2) {
+                return false;
             }
+            const Real variance = squaredDeviations / static_cast<Real>(samples - 1);
+            const Real confidence = Real(1.96) * std::sqrt(variance / static_cast<Real>(samples));
+            return confidence <= errorThreshold * std::max(meanLuminance, Real(1e-2));
         }
+    };
 
-        if (samples > 0) {
-            accumulatedColor /= samples;
-            return accumulatedColor;
+    // Echantillonnage adaptatif : au moins camera.minSamples, puis on continue tant que l'intervalle
+    // de confiance de la luminance moyenne depasse sampleErrorThreshold, jusqu'a camera.SampleCount().
+    Vec3 GeneratePixelAt(const int x, const int y) const {
+        constexpr Real bias = Real(1e-3);
+        const int minSamples = std::max(1, camera.minSamples);
+        const int maxSamples = camera.SampleCount();
+
+        PixelEstimate estimate;
+        while (estimate.samples < maxSamples) {
+            estimate.Add(GenerateAntiAliasing(x, y, static_cast<uint32_t>(estimate.samples), static_cast<uint32_t>(maxSamples), bias));
+            if (estimate.samples >= minSamples && estimate.Converged(camera.sampleErrorThreshold)) {
+                break;
+            }
         }
 
-        return Vec3{ 0, 0, 0 };
+        return estimate.meanColor;
     }
 
-    std::optional<Vec3> GenerateAntiAliasing(const size_t x, const size_t y, const bool isActive, const double bias) const {
-        const Rayon ray = camera.getRay(x, y, isActive);
-        return TraceRay(ray, 0, bias);
+    // Rend une tuile par blocs de PACKET_SIZE x PACKET_SIZE pixels : a chaque tour, les rayons primaires
+    // des pixels du bloc qui n'ont pas encore converge forment un paquet, les rebonds sont tires un par un.
+    void RenderTilePackets(const Tile& tile, std::vector<Vec3>& tileBuffer, const std::span<PixelCost> costs) const {
+        constexpr uint32_t PACKET_SIZE = 8;
+        constexpr Real bias = Real(1e-3);
+        const int minSamples = std::max(1, camera.minSamples);
+        const int maxSamples = camera.SampleCount();
+
+        std::array<PixelEstimate, PACKET_SIZE * PACKET_SIZE> estimates;
+        std::array<uint32_t, PACKET_SIZE * PACKET_SIZE> active;
+        thread_local std::vector<Rayon> rays;
+        thread_local std::vector<std::optional<HitInfo>> hits;
+        const bool tracing = Tracer::Enabled();
+
+        for (uint32_t by = tile.y0; by < tile.y1; by += PACKET_SIZE) {
+            for (uint32_t bx = tile.x0; bx < tile.x1; bx += PACKET_SIZE) {
+                const int64_t traceBegin = tracing ? Tracer::Now() : 0;
+                const uint32_t blockWidth = std::min(PACKET_SIZE, tile.x1 - bx);
+                const uint32_t blockHeight = std::min(PACKET_SIZE, tile.y1 - by);
+                uint32_t activeCount = blockWidth * blockHeight;
+                for (uint32_t i = 0; i < activeCount; ++i) {
+                    estimates[i] = PixelEstimate{};
+                    active[i] = i;
+                }
+
+                for (uint32_t sample = 0; sample < static_cast<uint32_t>(maxSamples) && activeCount > 0; ++sample) {
+                    rays.clear();
+                    for (uint32_t k = 0; k < activeCount; ++k) {
+                        rays.push_back(camera.getRay(bx + active[k] % blockWidth, by + active[k] / blockWidth, sample, static_cast<uint32_t>(maxSamples)));
+                    }
+                    hits.resize(rays.size());
+                    const CostSample packetBegin = costs.empty() ? CostSample{} : Stats::Sample();
+                    {
+                        // les rayons sont comptes par TraceRay, seuls les tests du paquet sont attribues ici
+                        const Stats::RayScope statsScope(RayKind::PRIMARY);
+                        IntersectPacket(rays, hits);
+                    }
+                    // le cout du paquet est reparti a parts egales entre ses pixels
+                    const CostSample packetEnd = costs.empty() ? CostSample{} : Stats::Sample();
+
+                    uint32_t stillActive = 0;
+                    for (uint32_t k = 0; k < activeCount; ++k) {
+                        PixelEstimate& estimate = estimates[active[k]];
+                        const uint32_t pixel = camera.pixelIndex(bx + active[k] % blockWidth, by + active[k] / blockWidth);
+                        const CostSample costBegin = costs.empty() ? CostSample{} : Stats::Sample();
+                        estimate.Add(TraceRay(rays[k], bias, hits[k], SampleContext{ pixel, sample }));
+                        if (!costs.empty()) {
+                            costs[pixel].Add(costBegin, Stats::Sample());
+                            costs[pixel].Add(packetBegin, packetEnd, 1.0f / static_cast<float>(activeCount));
+                        }
+                        if (estimate.samples < minSamples || !estimate.Converged(camera.sampleErrorThreshold)) {
+                            active[stillActive++] = active[k];
+                        }
+                    }
+                    activeCount = stillActive;
+                }
+
+                for (uint32_t i = 0; i < blockWidth * blockHeight; ++i) {
+                    const uint32_t x = bx + i % blockWidth;
+                    const uint32_t y = by + i / blockWidth;
+                    tileBuffer[(y - tile.y0) * tile.Width() + (x - tile.x0)] = estimates[i].meanColor;
+                }
+                // les pixels d'un bloc sont rendus ensemble, c'est le bloc qui est trace
+                if (tracing) {
+                    Tracer::RecordHeavy("packet", traceBegin, bx, by);
+                }
+            }
+        }
     }
 
-    std::vector<Vec3> RenderImage() const {
-        std::vector<Vec3> finalImage(camera.width * camera.height, Vec3(0, 0, 0));
+    Vec3 GenerateAntiAliasing(const size_t x, const size_t y, const uint32_t sampleIndex, const uint32_t sampleCount, const Real bias) const {
+        const Rayon ray = camera.getRay(x, y, sampleIndex, sampleCount);
+        return TraceRay(ray, bias, SampleContext{ camera.pixelIndex(x, y), sampleIndex });
+    }
+
+    std::vector<Vec3> RenderImage() {
+        TRACE_SCOPE("RenderImage");
+        if (accelerationDirty) {
+            BuildAccelerationStructure();
+        }
 
-        const int width = static_cast<int>(camera.width);
-        const int height = static_cast<int>(camera.height);
-        const int totalPixels = width * height;
+        costMap.assign(recordCost ? camera.width * camera.height : 0, PixelCost{});
+        const std::span<PixelCost> costs(costMap);
 
-        #ifdef _OPENMP
-        #pragma omp parallel for schedule(dynamic)
-        #endif
-        for (int idx = 0; idx < totalPixels; ++idx) {
-            const int x = idx % width;
-            const int y = idx / width;
-            finalImage[idx] = GeneratePixelAt(x, y);
+        if (renderMode == RenderMode::WAVEFRONT) {
+            return RenderWavefront(costs);
         }
 
+        std::vector<Vec3> finalImage(camera.width * camera.height, Vec3(0, 0, 0));
+        const size_t width = camera.width;
+
+        const TileScheduler scheduler(camera.width, camera.height, tileSize, tileOrder);
+        scheduler.Run([&](const Tile& tile) {
+            TRACE_SCOPE("tile", "render", "x", tile.x0, "y", tile.y0);
+            // la tuile est rendue dans un buffer local puis recopiee ligne par ligne
+            thread_local std::vector<Vec3> tileBuffer;
+            tileBuffer.resize(static_cast<size_t>(tile.Width()) * tile.Height());
+
+            if (packetTracing) {
+                RenderTilePackets(tile, tileBuffer, costs);
+            } else {
+                const bool tracing = Tracer::Enabled();
+                for (uint32_t y = tile.y0; y < tile.y1; ++y) {
+                    for (uint32_t x = tile.x0; x < tile.x1; ++x) {
+                        const CostSample costBegin = costs.empty() ? CostSample{} : Stats::Sample();
+                        const int64_t traceBegin = tracing ? Tracer::Now() : 0;
+                        tileBuffer[(y - tile.y0) * tile.Width() + (x - tile.x0)] = GeneratePixelAt(static_cast<int>(x), static_cast<int>(y));
+                        if (tracing) {
+                            Tracer::RecordHeavy("pixel", traceBegin, x, y);
+                        }
+                        if (!costs.empty()) {
+                            costs[GetPixelIndex(x, y)].Add(costBegin, Stats::Sample());
+                        }
+                    }
+                }
+            }
+
+            for (uint32_t row = 0; row < tile.Height(); ++row) {
+                const auto src = tileBuffer.begin() + static_cast<std::ptrdiff_t>(row) * tile.Width();
+                std::copy(src, src + tile.Width(), finalImage.begin() + static_cast<std::ptrdiff_t>((tile.y0 + row) * width + tile.x0));
+            }
+        }, ThreadPool::Global(), progressCallback);
+
         return finalImage;
     }
 };
\ No newline at end of file
@@ -2,34 +2,49 @@
 
 #include <vector>
 #include <optional>
+#include <memory>
+#include <tuple>
 #include "Math.h"
+#include "BVH.h"
+#include "TriangleStore.h"
+#include "Stats.h"
+#include "Trace.h"
 
 struct Transform {
     Vec3 position;
-    Vec3 rotation;
-    Vec3 scale;
+    Vec3 rotation; // radians
+    Vec3 scale = Vec3(1, 1, 1);
+
+    Matrix3x4 ToMatrix() const { return Matrix3x4::FromTRS(position, rotation, scale); }
 };
 
 struct Material {
     Vec3 color;
-    double shininess = 128.0;
-    double specular = 0.0;
-    double transparency = 0.0;
-    double refractiveIndex = 1.0;
+    Real shininess = 128.0;
+    Real specular = 0.0;
+    Real transparency = 0.0;
+    Real refractiveIndex = 1.0;
+
+    bool operator==(const Material&) const = default;
 };
 
+// Index into the scene material table (Scene::AddMaterial). Primitives and hits only carry
+// the index, the Material itself is looked up once at the shading point. 0 is the default Material.
+using MaterialId = uint32_t;
+
 enum class HitType: unsigned char {
 	NONE,
 	SPHERE,
 	PLANE,
-	TRIANGLE
+	TRIANGLE,
+	MODEL
 };
 
 struct HitInfo {
     HitType type;
-    double distance;
+    MaterialId materialId;
+    Real distance;
     size_t index;
-    Material material;
     Vec3 normal;
     Vec3 hitPoint;
 
@@ -37,7 +52,7 @@ struct HitInfo {
         return distance < other.distance;
     }
 
-    double normalizedDistance(const Camera& camera) const {
+    Real normalizedDistance(const Camera& camera) const {
         return (distance - camera.nearPlaneDistance) / (camera.farPlaneDistance - camera.nearPlaneDistance);
     }
 
@@ -58,36 +73,37 @@ struct HitInfo {
 
 class Sphere {
 private:
-    double radius;
+    Real radius;
     Transform transform;
-    Material material;
+    MaterialId material;
 public:
-    explicit Sphere(const double r = 1.0, const Vec3& pos = Vec3(0, 0, 0), const Material& mat = Material()) : radius(r) {
+    explicit Sphere(const Real r = 1.0, const Vec3& pos = Vec3(0, 0, 0), const MaterialId mat = 0) : radius(r) {
         transform.position = pos;
         transform.rotation = Vec3(0, 0, 0);
         transform.scale = Vec3(1, 1, 1);
         this->material = mat;
     }
 
-    std::optional<double> Intersect(const Rayon& ray) const {
+    std::optional<Real> Intersect(const Rayon& ray) const {
+        Stats::CountTests(ShapeKind::SPHERE);
         const Vec3 oc = ray.origin - transform.position;
 
-        const double a = ray.direction.dot(ray.direction);
-        const double b = 2.0 * oc.dot(ray.direction);
-        const double c = oc.dot(oc) - radius * radius;
+        const Real a = ray.direction.dot(ray.direction);
+        const Real b = Real(2) * oc.dot(ray.direction);
+        const Real c = oc.dot(oc) - radius * radius;
 
-        const double discriminant = b * b - 4.0 * a * c;
+        const Real discriminant = b * b - Real(4) * a * c;
         if (discriminant < 0.0) {
             return std::nullopt;
         }
 
-        const double sqrtDisc = std::sqrt(discriminant);
-        double t0 = (-b - sqrtDisc) / (2.0 * a);
-        double t1 = (-b + sqrtDisc) / (2.0 * a);
+        const Real sqrtDisc = std::sqrt(discriminant);
+        Real t0 = (-b - sqrtDisc) / (Real(2) * a);
+        Real t1 = (-b + sqrtDisc) / (Real(2) * a);
         if (t0 > t1) std::swap(t0, t1);
 
-        const double eps = 1e-6;
-        double t = t0;
+        const Real eps = Real(1e-6);
+        Real t = t0;
         if (t < eps) {
             t = t1;
             if (t < eps) {
@@ -103,15 +119,15 @@ public:
 
     std::optional<HitInfo> GetHitInfoAt(const Rayon& ray, const size_t index) const {
         if (const auto intersectionOpt = Intersect(ray); intersectionOpt) {
-            const double intersection = intersectionOpt.value();
+            const Real intersection = intersectionOpt.value();
 
             const Vec3 hitPoint = ray.pointAtDistance(intersection);
             const Vec3 normal = GetNormalAt(hitPoint).value();
             return HitInfo{
 				.type = HitType::SPHERE,
+				.materialId = material,
 				.distance = intersection,
 				.index = index,
-				.material = material,
 				.normal = normal,
 				.hitPoint = hitPoint
             };
@@ -120,10 +136,17 @@ public:
         return std::nullopt;
     }
 
-    double getRadius() const { return radius; }
-    void setRadius(double r) { radius = r; }
+    AABB GetBounds() const {
+        AABB bounds;
+        bounds.expand(transform.position - radius);
+        bounds.expand(transform.position + radius);
+        return bounds;
+    }
+
+    Real getRadius() const { return radius; }
+    void setRadius(Real r) { radius = r; }
 
-    Material getMaterial() const { return material; }
+    MaterialId getMaterialId() const { return material; }
     Transform getTransform() const { return transform; }
 
     static Sphere getHitObject(const HitInfo& hit, const std::vector<Sphere>& spheres)
@@ -136,9 +159,9 @@ class Plane {
 private:
     Vec3 normal;
     Transform transform;
-    Material material;
+    MaterialId material;
 public:
-    Plane(const Vec3& pos = Vec3(0, 1, 0), const Vec3& norm = Vec3(0, 1, 0), const Material& material = Material())
+    Plane(const Vec3& pos = Vec3(0, 1, 0), const Vec3& norm = Vec3(0, 1, 0), const MaterialId material = 0)
         : normal(norm.normalize()) {
         transform.position = pos;
         transform.rotation = Vec3(0, 0, 0);
@@ -146,11 +169,12 @@ public:
         this->material = material;
     }
 
-    std::optional<double> Intersect(const Rayon& ray) const {
-        const double denom = normal.dot(ray.direction);
+    std::optional<Real> Intersect(const Rayon& ray) const {
+        Stats::CountTests(ShapeKind::PLANE);
+        const Real denom = normal.dot(ray.direction);
         if (std::abs(denom) > 1e-6) {
             const Vec3 p0l0 = transform.position - ray.origin;
-            const double t = p0l0.dot(normal) / denom;
+            const Real t = p0l0.dot(normal) / denom;
             if (t >= 0.0) {
                 return { t };
             }
@@ -165,12 +189,12 @@ public:
     std::optional<HitInfo> GetHitInfoAt(const Rayon& ray, const size_t index) const {
         if (const auto intersectionOpt = Intersect(ray); intersectionOpt)
         {
-            const double intersection = intersectionOpt.value();
+            const Real intersection = intersectionOpt.value();
             return HitInfo {
 				.type = HitType::PLANE,
+				.materialId = material,
 				.distance = intersection,
 				.index = index,
-				.material = material,
 				.normal = GetNormalAt(),
 				.hitPoint = ray.pointAtDistance(intersection)
             };
@@ -181,17 +205,34 @@ public:
 
 	Vec3 GetNormal() const { return normal; }
 	void SetNormal(const Vec3& norm) { normal = norm.normalize(); }
-	Material GetMaterial() const { return material; }
+	MaterialId GetMaterialId() const { return material; }
 	Transform GetTransform() const { return transform; }
 };
 
+// Moller-Trumbore test against a triangle given by one vertex and its two edges
+inline std::optional<Real> IntersectTriangle(const Rayon& ray, const Vec3& v0, const Vec3& edge1, const Vec3& edge2) {
+	constexpr Real EPSILON = Real(1e-6);
+	const auto h = ray.direction.cross(edge2);
+	const Real a = edge1.dot(h);
+	if (a > -EPSILON && a < EPSILON) { return std::nullopt; }
+	const Real f = Real(1) / a;
+	const auto s = ray.origin - v0;
+	const Real u = f * s.dot(h);
+	if (u < 0.0 || u > 1.0) { return std::nullopt; }
+	const Vec3 q = s.cross(edge1);
+	const Real v = f * ray.direction.dot(q);
+	if (v < 0.0 || u + v > 1.0) { return std::nullopt; }
+	if (auto t = f * edge2.dot(q); t > EPSILON) { return { t }; }
+	return std::nullopt;
+}
+
 class Triangle {
 private:
 	Vec3 v0, v1, v2;
 	Transform transform; // now stored
-	Material material;
+	MaterialId material;
 public:
-	Triangle(const Vec3& vertex0, const Vec3& vertex1, const Vec3& vertex2, const Material& mat = Material(), const Transform& t = Transform())
+	Triangle(const Vec3& vertex0, const Vec3& vertex1, const Vec3& vertex2, const MaterialId mat = 0, const Transform& t = Transform())
 		: v0(vertex0), v1(vertex1), v2(vertex2), transform(t), material(mat) {}
 
 	// Apply translation (and simple uniform scale) from transform for intersection tests
@@ -199,24 +240,10 @@ public:
 	Vec3 tv1() const { return v1 + transform.position; }
 	Vec3 tv2() const { return v2 + transform.position; }
 
-	std::optional<double> Intersect(const Rayon& ray) const {
-		constexpr double EPSILON = 1e-6;
+	std::optional<Real> Intersect(const Rayon& ray) const {
+		Stats::CountTests(ShapeKind::TRIANGLE);
 		const auto a0 = tv0();
-		const auto edge1 = tv1() - a0;
-		const auto edge2 = tv2() - a0;
-
-		const auto h = ray.direction.cross(edge2);
-		const double a = edge1.dot(h);
-		if (a > -EPSILON && a < EPSILON) { return std::nullopt; }
-		const double f = 1.0 / a;
-		const auto s = ray.origin - a0;
-		const double u = f * s.dot(h);
-		if (u < 0.0 || u > 1.0) { return std::nullopt; }
-		const Vec3 q = s.cross(edge1);
-		const double v = f * ray.direction.dot(q);
-		if (v < 0.0 || u + v > 1.0) { return std::nullopt; }
-		if (auto t = f * edge2.dot(q); t > EPSILON) { return { t }; }
-		return std::nullopt;
+		return IntersectTriangle(ray, a0, tv1() - a0, tv2() - a0);
 	}
 
 	std::optional<Vec3> GetNormalAt() const {
@@ -232,9 +259,9 @@ public:
 			const Vec3 normal = GetNormalAt().value();
             return HitInfo{
                 .type = HitType::TRIANGLE,
+                .materialId = material,
 				.distance = intersection.value(),
                 .index = index,
-                .material = material,
                 .normal = normal,
 				.hitPoint = hitPoint
             };
@@ -242,66 +269,197 @@ public:
 		return std::nullopt;
 	}
 
-	Material GetMaterial() const { return material; }
+	AABB GetBounds() const {
+		AABB bounds;
+		bounds.expand(tv0());
+		bounds.expand(tv1());
+		bounds.expand(tv2());
+		bounds.min = bounds.min - Real(1e-6);
+		bounds.max = bounds.max + Real(1e-6);
+		return bounds;
+	}
+
+	MaterialId GetMaterialId() const { return material; }
 };
 
-class Model
+// Triangle mesh geometry shared between every Model placing it in the scene.
+// Positions and the bottom-level BVH are expressed in object space.
+class Mesh
 {
 private:
     std::vector<int> vertices;
-	std::vector<Vec3> vertexPositions;
-	Transform transform;
-	Material material;
+    std::vector<Vec3> vertexPositions;
+    std::vector<Vec3> normals;
+    TriangleStore store; // triangles in BVH leaf order, slot i is triangle bvh.PrimitiveOrder()[i]
+    BVH bvh;
+
+    Vec3 GetVertex(const size_t triangleIndex, const size_t corner) const {
+        return vertexPositions[vertices[triangleIndex * 3 + corner]];
+    }
+
 public:
-	Model(const std::vector<int>& vertices, const Transform& transform = Transform(), const Material& material = Material(), const std::vector<Vec3>& vertexPositions = std::vector<Vec3>()) : vertices(vertices), transform(transform), material(material), vertexPositions(vertexPositions) {}
+    Mesh(std::vector<int> vertices, std::vector<Vec3> vertexPositions) : vertices(std::move(vertices)), vertexPositions(std::move(vertexPositions)) {
+        BuildBVH();
+    }
 
-    std::vector<Triangle> GetTrianglesFromModel(const Material& overrideMaterial) const {
+    void BuildBVH() {
+        TRACE_SCOPE("Mesh::BuildBVH", "build", "triangles", static_cast<int64_t>(TriangleCount()));
+        std::vector<AABB> triangleBounds(TriangleCount());
+        normals.resize(TriangleCount());
+        ThreadPool::Global().ParallelFor(0, triangleBounds.size(), 4096, [&](const size_t begin, const size_t end) {
+            for (size_t t = begin; t < end; ++t) {
+                for (size_t k = 0; k < 3; ++k) {
+                    triangleBounds[t].expand(vertexPositions[vertices[t * 3 + k]]);
+                }
+                // pad flat boxes so axis aligned triangles still have a volume for the slab test
+                triangleBounds[t].min = triangleBounds[t].min - Real(1e-6);
+                triangleBounds[t].max = triangleBounds[t].max + Real(1e-6);
+                normals[t] = (GetVertex(t, 1) - GetVertex(t, 0)).cross(GetVertex(t, 2) - GetVertex(t, 0)).normalize();
+            }
+        });
+        bvh.Build(triangleBounds);
+
+        const auto& order = bvh.PrimitiveOrder();
+        store.Build(order.size(), [&](const size_t slot) {
+            return std::tuple{ GetVertex(order[slot], 0), GetVertex(order[slot], 1), GetVertex(order[slot], 2) };
+        });
+    }
+
+    size_t TriangleCount() const { return vertices.size() / 3; }
+
+    AABB GetBounds() const { return bvh.Bounds(); }
+
+    // Closest hit along an object space ray, returns the triangle index and updates tMax
+    std::optional<uint32_t> IntersectClosest(const Rayon& ray, Real& tMax) const {
+        uint32_t closestSlot = 0;
+        const bool hit = bvh.TraverseLeaves(ray, tMax, [&](const uint32_t first, const uint32_t count, Real& currentMax) {
+            return store.IntersectRange(ray, first, count, currentMax, closestSlot);
+        });
+        if (!hit) {
+            return std::nullopt;
+        }
+        return bvh.PrimitiveOrder()[closestSlot];
+    }
+
+    // Any hit in ]minDist, maxDist[, the shadow window shared with spheres and planes
+    bool IntersectAnyBefore(const Rayon& ray, const Real maxDist, const Real minDist = 0) const {
+        return bvh.TraverseLeavesAny(ray, maxDist, [&](const uint32_t first, const uint32_t count) {
+            return store.IntersectRangeAny(ray, first, count, minDist, maxDist);
+        });
+    }
+
+    Vec3 GetNormal(const uint32_t triangleIndex) const {
+        return normals[triangleIndex];
+    }
+
+    std::vector<Triangle> GetTriangles(const MaterialId material, const Matrix3x4& objectToWorld) const {
         std::vector<Triangle> triangles;
+        triangles.reserve(TriangleCount());
         for (size_t i = 0; i < vertices.size(); i += 3) {
-            Vec3 v0 = vertexPositions[vertices[i]];
-            Vec3 v1 = vertexPositions[vertices[i + 1]];
-            Vec3 v2 = vertexPositions[vertices[i + 2]];
-            triangles.emplace_back(Triangle(v0, v1, v2, overrideMaterial, transform));
+            triangles.emplace_back(
+                objectToWorld.TransformPoint(vertexPositions[vertices[i]]),
+                objectToWorld.TransformPoint(vertexPositions[vertices[i + 1]]),
+                objectToWorld.TransformPoint(vertexPositions[vertices[i + 2]]),
+                material);
         }
         return triangles;
+    }
+};
+
+// Instance of a shared Mesh: rays are moved into object space at the instance boundary.
+// The direction is not renormalized so hit distances stay in world units.
+class Model
+{
+private:
+    std::shared_ptr<const Mesh> mesh;
+	Transform transform;
+	Matrix3x4 objectToWorld;
+	Matrix3x4 worldToObject;
+	MaterialId material;
+
+    Rayon ToObject(const Rayon& ray) const {
+        return Rayon{ worldToObject.TransformPoint(ray.origin), worldToObject.TransformVector(ray.direction) };
+    }
+
+public:
+	Model(const std::vector<int>& vertices, const Transform& transform = Transform(), const MaterialId material = 0, const std::vector<Vec3>& vertexPositions = std::vector<Vec3>())
+        : Model(std::make_shared<const Mesh>(vertices, vertexPositions), transform, material) {}
+
+	Model(std::shared_ptr<const Mesh> mesh, const Transform& transform, const MaterialId material = 0)
+        : mesh(std::move(mesh)), material(material) {
+        SetTransform(transform);
+    }
+
+	Model(std::shared_ptr<const Mesh> mesh, const Matrix3x4& objectToWorld, const MaterialId material = 0)
+        : mesh(std::move(mesh)), material(material) {
+        SetMatrix(objectToWorld);
+    }
+
+    std::vector<Triangle> GetTrianglesFromModel(const MaterialId overrideMaterial) const {
+        return mesh->GetTriangles(overrideMaterial, objectToWorld);
 	}
 
-    std::optional<HitInfo> GetHitInfoAt(const Rayon& ray, const size_t index) const {
-        std::optional<HitInfo> closestHit = std::nullopt;
-        for (size_t i = 0; i < vertices.size(); i += 3) {
-            Vec3 v0 = vertexPositions[vertices[i]];
-            Vec3 v1 = vertexPositions[vertices[i + 1]];
-            Vec3 v2 = vertexPositions[vertices[i + 2]];
-            Triangle triangle(v0, v1, v2, material, transform);
-            if (auto hitOpt = triangle.GetHitInfoAt(ray, index); hitOpt) {
-                if (HitInfo hit = hitOpt.value(); !closestHit.has_value() || hit.isCloserThan(closestHit.value())) {
-                    closestHit = hit;
-                }
-            }
+    AABB GetBounds() const {
+        const AABB objectBounds = mesh->GetBounds();
+        AABB bounds;
+        if (!objectBounds.isValid()) {
+            return bounds;
         }
-        return closestHit;
+        for (int corner = 0; corner < 8; ++corner) {
+            const Vec3 p{
+                (corner & 1) ? objectBounds.max.x : objectBounds.min.x,
+                (corner & 2) ? objectBounds.max.y : objectBounds.min.y,
+                (corner & 4) ? objectBounds.max.z : objectBounds.min.z
+            };
+            bounds.expand(objectToWorld.TransformPoint(p));
+        }
+        return bounds;
+    }
+
+    std::optional<HitInfo> GetHitInfoAt(const Rayon& ray, const size_t index, const Real maxDistance = std::numeric_limits<Real>::infinity()) const {
+        Real closestT = maxDistance;
+        const auto triangleOpt = mesh->IntersectClosest(ToObject(ray), closestT);
+        if (!triangleOpt) {
+            return std::nullopt;
+        }
+
+        return HitInfo{
+            .type = HitType::MODEL,
+            .materialId = material,
+            .distance = closestT,
+            .index = index,
+            .normal = worldToObject.TransposeTransformVector(mesh->GetNormal(triangleOpt.value())).normalize(),
+            .hitPoint = ray.pointAtDistance(closestT)
+        };
 	}
 
-    std::optional<double> Intersect(const Rayon& ray) const {
-        std::optional<double> closestT = std::nullopt;
-        for (size_t i = 0; i < vertices.size(); i += 3) {
-            Vec3 v0 = vertexPositions[vertices[i]];
-            Vec3 v1 = vertexPositions[vertices[i + 1]];
-            Vec3 v2 = vertexPositions[vertices[i + 2]];
-            Triangle triangle(v0, v1, v2, material, transform);
-            if (auto tOpt = triangle.Intersect(ray); tOpt) {
-                double t = tOpt.value();
-                if (!closestT.has_value() || t < closestT.value()) {
-                    closestT = t;
-                }
-            }
+    std::optional<Real> Intersect(const Rayon& ray) const {
+        Real closestT = std::numeric_limits<Real>::infinity();
+        if (!mesh->IntersectClosest(ToObject(ray), closestT)) {
+            return std::nullopt;
         }
         return closestT;
 	}
 
+    bool IntersectAnyBefore(const Rayon& ray, const Real maxDist, const Real minDist = 0) const {
+        return mesh->IntersectAnyBefore(ToObject(ray), maxDist, minDist);
+    }
+
+	std::shared_ptr<const Mesh> GetMesh() const { return mesh; }
 	Transform GetTransform() const { return transform; }
-	Material GetMaterial() const { return material; }
+	Matrix3x4 GetMatrix() const { return objectToWorld; }
+	MaterialId GetMaterialId() const { return material; }
 
-	void SetTransform(const Transform& t) { transform = t; }
-	void SetMaterial(const Material& m) { material = m; }
-};
\ No newline at end of file
+	void SetTransform(const Transform& t) {
+        transform = t;
+        objectToWorld = t.ToMatrix();
+        worldToObject = objectToWorld.Inverse();
+    }
+	// Arbitrary affine placement, GetTransform then returns the default Transform
+	void SetMatrix(const Matrix3x4& matrix) {
+        transform = Transform();
+        objectToWorld = matrix;
+        worldToObject = matrix.Inverse();
+    }
+	void SetMaterialId(const MaterialId m) { material = m; }
+};
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+
+// Compteurs de rendu (rayons par type, tests par forme, profondeur des chemins), compiles
+// seulement avec RAYTRACING_STATS. Sans la macro, seuls restent les deux totaux par thread
+// (rayons, tests) lus par la carte de cout.
+#if defined(RAYTRACING_STATS)
+inline constexpr bool STATS_ENABLED = true;
+#else
+inline constexpr bool STATS_ENABLED = false;
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define RAYTRACING_HAS_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define RAYTRACING_HAS_RDTSC 1
+#endif
+
+// Compteur de temps le moins cher disponible : cycles TSC sur x86, nanosecondes steady_clock ailleurs
+inline uint64_t ReadCycleCounter() {
+#if defined(RAYTRACING_HAS_RDTSC)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+enum class RayKind : uint8_t {
+    PRIMARY,
+    SHADOW,
+    REFLECTION,
+    REFRACTION,
+    COUNT,
+};
+
+enum class ShapeKind : uint8_t {
+    SPHERE,
+    PLANE,
+    TRIANGLE,
+    COUNT,
+};
+
+struct RenderStats {
+    static constexpr size_t RAY_KINDS = static_cast<size_t>(RayKind::COUNT);
+    static constexpr size_t SHAPE_KINDS = static_cast<size_t>(ShapeKind::COUNT);
+
+    std::array<uint64_t, RAY_KINDS> rays{};
+    std::array<std::array<uint64_t, SHAPE_KINDS>, RAY_KINDS> tests{}; // par type de rayon courant
+    uint64_t pathEnds = 0;     // sommets sans rebond garde, un par feuille de l'arbre du chemin
+    uint64_t pathDepthSum = 0; // somme des profondeurs de ces feuilles
+
+    RenderStats& operator+=(const RenderStats& o) {
+        for (size_t k = 0; k < RAY_KINDS; ++k) {
+            rays[k] += o.rays[k];
+            for (size_t s = 0; s < SHAPE_KINDS; ++s) {
+                tests[k][s] += o.tests[k][s];
+            }
+        }
+        pathEnds += o.pathEnds;
+        pathDepthSum += o.pathDepthSum;
+        return *this;
+    }
+
+    // Rapport d'une image rendue en seconds secondes
+    void Print(std::ostream& out, const double seconds) const {
+        static constexpr const char* RAY_NAMES[RAY_KINDS] = { "primaires", "ombre", "reflexion", "refraction" };
+        static constexpr const char* SHAPE_NAMES[SHAPE_KINDS] = { "sphere", "plan", "triangle" };
+
+        const auto flags = out.flags();
+        const auto precision = out.precision();
+        out << std::fixed << std::setprecision(2);
+
+        uint64_t totalRays = 0;
+        for (size_t k = 0; k < RAY_KINDS; ++k) {
+            totalRays += rays[k];
+            out << "Rayons " << std::left << std::setw(10) << RAY_NAMES[k] << std::right << " : " << std::setw(12) << rays[k]
+                << "  " << std::setw(8) << (seconds > 0 ? static_cast<double>(rays[k]) / seconds * 1e-6 : 0.0) << " Mrays/s  tests/rayon :";
+            for (size_t s = 0; s < SHAPE_KINDS; ++s) {
+                out << " " << SHAPE_NAMES[s] << " " << (rays[k] > 0 ? static_cast<double>(tests[k][s]) / static_cast<double>(rays[k]) : 0.0);
+            }
+            out << "\n";
+        }
+        out << "Total : " << totalRays << " rayons, " << (seconds > 0 ? static_cast<double>(totalRays) / seconds * 1e-6 : 0.0) << " Mrays/s\n";
+        out << "Profondeur moyenne des chemins : " << (pathEnds > 0 ? static_cast<double>(pathDepthSum) / static_cast<double>(pathEnds) : 0.0) << "\n";
+
+        out.flags(flags);
+        out.precision(precision);
+    }
+};
+
+// Releve des compteurs cumules du thread courant : la difference de deux releves donne le cout
+// du travail fait entre les deux sur ce thread, avec ou sans RAYTRACING_STATS.
+struct CostSample {
+    uint64_t cycles = 0;
+    uint64_t rays = 0;
+    uint64_t tests = 0;
+};
+
+// Cout de rendu d'un pixel, accumule en float pour etre ecrit tel quel dans un buffer
+struct PixelCost {
+    float cycles = 0;
+    float rays = 0;
+    float tests = 0;
+
+    // share repartit un cout commun (paquet de rayons primaires) entre plusieurs pixels
+    void Add(const CostSample& begin, const CostSample& end, const float share = 1.0f) {
+        cycles += static_cast<float>(end.cycles - begin.cycles) * share;
+        rays += static_cast<float>(end.rays - begin.rays) * share;
+        tests += static_cast<float>(end.tests - begin.tests) * share;
+    }
+
+    PixelCost& operator+=(const PixelCost& o) {
+        cycles += o.cycles;
+        rays += o.rays;
+        tests += o.tests;
+        return *this;
+    }
+};
+
+// Chaque thread incremente son propre bloc sans synchronisation ; les blocs sont
+// enregistres a leur creation et additionnes par Collect une fois le rendu termine.
+class Stats {
+private:
+    static inline std::mutex registryMutex;
+    static inline std::vector<std::unique_ptr<RenderStats>> registry;
+    static inline thread_local RenderStats* local = nullptr;
+    static inline thread_local RayKind currentKind = RayKind::PRIMARY;
+    // totaux toujours comptes : un increment par rayon ou par lot de tests, sans registre
+    static inline constinit thread_local CostSample costTotals;
+
+    static RenderStats& Local() {
+        if (!local) {
+            const std::lock_guard lock(registryMutex);
+            registry.push_back(std::make_unique<RenderStats>());
+            local = registry.back().get();
+        }
+        return *local;
+    }
+
+public:
+    // Type du rayon dont les tests suivants font partie, restaure a la sortie du scope
+    class RayScope {
+    private:
+        RayKind previous;
+
+    public:
+        explicit RayScope(const RayKind kind) : previous(currentKind) {
+            if constexpr (STATS_ENABLED) {
+                currentKind = kind;
+            }
+        }
+        ~RayScope() {
+            if constexpr (STATS_ENABLED) {
+                currentKind = previous;
+            }
+        }
+        RayScope(const RayScope&) = delete;
+        RayScope& operator=(const RayScope&) = delete;
+    };
+
+    static void CountRay(const RayKind kind) {
+        ++costTotals.rays;
+        if constexpr (STATS_ENABLED) {
+            ++Local().rays[static_cast<size_t>(kind)];
+        }
+    }
+
+    static void CountTests(const ShapeKind shape, const uint64_t count = 1) {
+        costTotals.tests += count;
+        if constexpr (STATS_ENABLED) {
+            Local().tests[static_cast<size_t>(currentKind)][static_cast<size_t>(shape)] += count;
+        }
+    }
+
+    static void CountPathEnd(const int depth) {
+        if constexpr (STATS_ENABLED) {
+            RenderStats& stats = Local();
+            ++stats.pathEnds;
+            stats.pathDepthSum += static_cast<uint64_t>(depth);
+        }
+    }
+
+    static CostSample Sample() {
+        CostSample sample = costTotals;
+        sample.cycles = ReadCycleCounter();
+        return sample;
+    }
+
+    // A appeler hors rendu : les threads ne doivent plus ecrire dans leur bloc
+    static RenderStats Collect() {
+        RenderStats total;
+        const std::lock_guard lock(registryMutex);
+        for (const auto& block : registry) {
+            total += *block;
+        }
+        return total;
+    }
+
+    static void Reset() {
+        const std::lock_guard lock(registryMutex);
+        for (const auto& block : registry) {
+            *block = RenderStats{};
+        }
+    }
+};
@@ -0,0 +1,56 @@
+#include "ThreadPool.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+thread_local ThreadPool* ThreadPool::currentPool = nullptr;
+thread_local size_t ThreadPool::currentWorker = 0;
+
+namespace {
+    std::unique_ptr<ThreadPool>& globalPool() {
+        static std::unique_ptr<ThreadPool> pool;
+        return pool;
+    }
+    std::mutex globalPoolMutex;
+}
+
+ThreadPool& ThreadPool::Global()
+{
+    const std::lock_guard lock(globalPoolMutex);
+    auto& pool = globalPool();
+    if (!pool) {
+        pool = std::make_unique<ThreadPool>();
+    }
+    return *pool;
+}
+
+void ThreadPool::ConfigureGlobal(const unsigned threadCount, const bool pinThreads)
+{
+    const std::lock_guard lock(globalPoolMutex);
+    auto& pool = globalPool();
+    pool.reset();
+    pool = std::make_unique<ThreadPool>(threadCount, pinThreads);
+}
+
+void ThreadPool::PinCurrentThread(const unsigned core)
+{
+    const unsigned coreCount = std::max(1u, std::thread::hardware_concurrency());
+#if defined(_WIN32)
+    if (coreCount <= 64) {
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (core % coreCount));
+    }
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core % coreCount, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)core;
+    (void)coreCount;
+#endif
+}
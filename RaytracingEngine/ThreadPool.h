@@ -0,0 +1,250 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <utility>
+#include <string>
+
+#include "Trace.h"
+
+// Pool de taches a vol de travail, backend d'execution de tout le moteur (rendu, BVH, chargement,
+// tonemapping, ecriture). Chaque worker a sa deque : il empile et depile par l'arriere, les
+// autres volent par l'avant. Les taches soumises hors du pool vont dans une deque partagee,
+// toujours prise par l'avant pour garder l'ordre de soumission (ordre des tuiles).
+// Un thread qui attend une TaskGroup execute des taches au lieu de bloquer, les taches
+// peuvent donc elles-memes lancer et attendre des sous-taches ; sans tache a prendre, il dort
+// jusqu'a la fin d'une tache ou la soumission d'une nouvelle.
+class ThreadPool {
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues; // une par worker, la derniere pour les threads externes
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queuedTasks{ 0 };
+    std::atomic<bool> stopping{ false };
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    std::condition_variable helperWakeUp;      // threads bloques dans HelpUntil
+    std::atomic<size_t> waitingHelpers{ 0 };   // modifie sous sleepMutex
+
+    static thread_local ThreadPool* currentPool;
+    static thread_local size_t currentWorker;
+
+    size_t ExternalQueue() const noexcept { return queues.size() - 1; }
+
+    size_t CallerQueue() const noexcept {
+        return currentPool == this ? currentWorker : ExternalQueue();
+    }
+
+    bool PopTask(const size_t self, std::function<void()>& task) {
+        {
+            // seul un worker depile sa propre deque par l'arriere, la deque externe reste FIFO
+            WorkQueue& own = *queues[self];
+            const std::lock_guard lock(own.mutex);
+            if (!own.tasks.empty()) {
+                if (self == ExternalQueue()) {
+                    task = std::move(own.tasks.front());
+                    own.tasks.pop_front();
+                } else {
+                    task = std::move(own.tasks.back());
+                    own.tasks.pop_back();
+                }
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < queues.size(); ++offset) {
+            WorkQueue& victim = *queues[(self + offset) % queues.size()];
+            const std::lock_guard lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool TryRunOne(const size_t self) {
+        std::function<void()> task;
+        if (!PopTask(self, task)) {
+            return false;
+        }
+        queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+        task();
+        // la tache a pu terminer ce qu'attend un HelpUntil endormi ; la barriere fait pendant
+        // a celle de HelpUntil pour qu'un des deux voie l'ecriture de l'autre
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waitingHelpers.load(std::memory_order_relaxed) > 0) {
+            {
+                const std::lock_guard lock(sleepMutex);
+            }
+            helperWakeUp.notify_all();
+        }
+        return true;
+    }
+
+    void WorkerLoop(const size_t index, const bool pinThread) {
+        currentPool = this;
+        currentWorker = index;
+        Tracer::SetThreadName("worker " + std::to_string(index));
+        if (pinThread) {
+            PinCurrentThread(static_cast<unsigned>(index + 1)); // le coeur 0 reste au thread principal
+        }
+        while (!stopping.load(std::memory_order_acquire)) {
+            if (!TryRunOne(index)) {
+                std::unique_lock lock(sleepMutex);
+                wakeUp.wait(lock, [this] { return stopping.load(std::memory_order_acquire) || queuedTasks.load(std::memory_order_relaxed) > 0; });
+            }
+        }
+    }
+
+    // Fixe l'affinite du thread courant (modulo le nombre de coeurs), sans effet si la plateforme ne le permet pas
+    static void PinCurrentThread(unsigned core);
+
+public:
+    // threadCount compte le thread appelant, qui travaille pendant qu'il attend (0 = un par coeur)
+    explicit ThreadPool(unsigned threadCount = 0, const bool pinThreads = false) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (unsigned i = 0; i < threadCount; ++i) {
+            queues.push_back(std::make_unique<WorkQueue>());
+        }
+        workers.reserve(threadCount - 1);
+        for (unsigned i = 0; i + 1 < threadCount; ++i) {
+            workers.emplace_back(&ThreadPool::WorkerLoop, this, i, pinThreads);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            const std::lock_guard lock(sleepMutex);
+            stopping.store(true, std::memory_order_release);
+        }
+        wakeUp.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned ThreadCount() const noexcept { return static_cast<unsigned>(workers.size() + 1); }
+
+    // Pool partage par le moteur, cree a la premiere utilisation
+    static ThreadPool& Global();
+    // Recree le pool global, a appeler avant le rendu et jamais pendant qu'il execute des taches
+    static void ConfigureGlobal(unsigned threadCount, bool pinThreads);
+
+    // La tache ne doit pas lever d'exception, passer par TaskGroup qui les capture
+    void Push(std::function<void()> task) {
+        {
+            WorkQueue& queue = *queues[CallerQueue()];
+            const std::lock_guard lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        queuedTasks.fetch_add(1, std::memory_order_relaxed);
+        bool helpersWaiting;
+        {
+            const std::lock_guard lock(sleepMutex);
+            helpersWaiting = waitingHelpers.load(std::memory_order_relaxed) > 0;
+        }
+        wakeUp.notify_one();
+        if (helpersWaiting) {
+            helperWakeUp.notify_all();
+        }
+    }
+
+    // Execute des taches en attendant que isDone() soit vrai, dort quand il n'y en a plus a
+    // prendre (la derniere tuile peut durer longtemps)
+    template <typename DoneFn>
+    void HelpUntil(DoneFn&& isDone) {
+        const size_t self = CallerQueue();
+        while (!isDone()) {
+            if (!TryRunOne(self)) {
+                std::unique_lock lock(sleepMutex);
+                waitingHelpers.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                helperWakeUp.wait(lock, [&] { return isDone() || queuedTasks.load(std::memory_order_relaxed) > 0; });
+                waitingHelpers.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Appelle body(chunkBegin, chunkEnd) sur des tranches d'au plus grain elements de [begin, end)
+    template <typename BodyFn>
+    void ParallelFor(size_t begin, size_t end, size_t grain, BodyFn&& body);
+};
+
+// Ensemble de taches attendues ensemble, la premiere exception levee est relancee par Wait
+class TaskGroup {
+private:
+    ThreadPool& pool;
+    std::atomic<size_t> pending{ 0 };
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::Global()) : pool(pool) {}
+
+    ~TaskGroup() {
+        pool.HelpUntil([this] { return pending.load(std::memory_order_acquire) == 0; });
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    template <typename TaskFn>
+    void Run(TaskFn&& task) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        pool.Push([this, task = std::forward<TaskFn>(task)]() mutable {
+            try {
+                task();
+            } catch (...) {
+                const std::lock_guard lock(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            pending.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    void Wait() {
+        pool.HelpUntil([this] { return pending.load(std::memory_order_acquire) == 0; });
+        if (error) {
+            std::rethrow_exception(std::exchange(error, nullptr));
+        }
+    }
+};
+
+template <typename BodyFn>
+void ThreadPool::ParallelFor(const size_t begin, const size_t end, size_t grain, BodyFn&& body) {
+    grain = std::max<size_t>(grain, 1);
+    if (end <= begin) {
+        return;
+    }
+    if (end - begin <= grain || ThreadCount() == 1) {
+        body(begin, end);
+        return;
+    }
+
+    TaskGroup group(*this);
+    for (size_t chunk = begin; chunk < end; chunk += grain) {
+        const size_t chunkEnd = std::min(end, chunk + grain);
+        group.Run([&body, chunk, chunkEnd] { body(chunk, chunkEnd); });
+    }
+    group.Wait();
+}
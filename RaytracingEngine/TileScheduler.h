@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include "ThreadPool.h"
+
+struct Tile {
+    uint32_t x0, y0; // coin haut gauche inclus
+    uint32_t x1, y1; // coin bas droit exclu
+    uint32_t index;  // position dans l'ordre de rendu
+
+    uint32_t Width() const noexcept { return x1 - x0; }
+    uint32_t Height() const noexcept { return y1 - y0; }
+};
+
+enum class TileOrder {
+    SCANLINE,
+    MORTON, // courbe en Z, les tuiles voisines sont rendues a la suite
+    SPIRAL, // du centre vers les bords, le sujet apparait en premier
+};
+
+// Decoupe l'image en tuiles et les distribue entieres aux workers du pool,
+// les taches sont empilees dans l'ordre choisi.
+class TileScheduler {
+private:
+    std::vector<Tile> tiles;
+
+    static uint32_t spreadBits(uint32_t v) noexcept {
+        v &= 0x0000ffff;
+        v = (v | (v << 8)) & 0x00ff00ff;
+        v = (v | (v << 4)) & 0x0f0f0f0f;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    }
+
+    static uint32_t morton(const uint32_t x, const uint32_t y) noexcept {
+        return spreadBits(x) | (spreadBits(y) << 1);
+    }
+
+public:
+    TileScheduler(const size_t width, const size_t height, const uint32_t tileSize, const TileOrder order) {
+        const uint32_t size = std::max<uint32_t>(tileSize, 1);
+        const uint32_t tilesX = static_cast<uint32_t>((width + size - 1) / size);
+        const uint32_t tilesY = static_cast<uint32_t>((height + size - 1) / size);
+
+        struct Keyed {
+            Tile tile;
+            int64_t ring;
+            double key;
+        };
+        std::vector<Keyed> keyed;
+        keyed.reserve(static_cast<size_t>(tilesX) * tilesY);
+
+        const double centerX = (tilesX - 1) * 0.5;
+        const double centerY = (tilesY - 1) * 0.5;
+        for (uint32_t ty = 0; ty < tilesY; ++ty) {
+            for (uint32_t tx = 0; tx < tilesX; ++tx) {
+                Tile tile{ tx * size, ty * size,
+                    static_cast<uint32_t>(std::min<size_t>(width, (tx + 1) * size)),
+                    static_cast<uint32_t>(std::min<size_t>(height, (ty + 1) * size)), 0 };
+
+                int64_t ring = 0;
+                double key = static_cast<double>(ty) * tilesX + tx;
+                if (order == TileOrder::MORTON) {
+                    key = morton(tx, ty);
+                } else if (order == TileOrder::SPIRAL) {
+                    // anneau de Chebyshev autour du centre, puis l'angle dans l'anneau
+                    const double dx = tx - centerX;
+                    const double dy = ty - centerY;
+                    ring = static_cast<int64_t>(std::ceil(std::max(std::abs(dx), std::abs(dy))));
+                    key = std::atan2(dy, dx);
+                }
+                keyed.push_back({ tile, ring, key });
+            }
+        }
+
+        std::stable_sort(keyed.begin(), keyed.end(), [](const Keyed& a, const Keyed& b) {
+            return a.ring != b.ring ? a.ring < b.ring : a.key < b.key;
+        });
+
+        tiles.reserve(keyed.size());
+        for (const Keyed& k : keyed) {
+            tiles.push_back(k.tile);
+            tiles.back().index = static_cast<uint32_t>(tiles.size() - 1);
+        }
+    }
+
+    const std::vector<Tile>& Tiles() const noexcept { return tiles; }
+
+    // Appelle renderTile(tile) pour chaque tuile sur le pool, une tache par tuile.
+    // onTileDone(tilesDone, tileCount) est appele depuis le worker qui vient de finir une tuile.
+    template <typename TileFn>
+    void Run(TileFn&& renderTile, ThreadPool& pool = ThreadPool::Global(),
+        const std::function<void(size_t, size_t)>& onTileDone = nullptr) const {
+        std::atomic<size_t> done{ 0 };
+        pool.ParallelFor(0, tiles.size(), 1, [&](const size_t first, const size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                renderTile(tiles[i]);
+                const size_t finished = done.fetch_add(1, std::memory_order_relaxed) + 1;
+                if (onTileDone) {
+                    onTileDone(finished, tiles.size());
+                }
+            }
+        });
+    }
+};
@@ -0,0 +1,622 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "Tonemap.h"
+#include "Trace.h"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#endif
+
+namespace {
+	// pixels par tranche : 4096 * sizeof(Vec3) tient dans le L2
+	constexpr size_t TONEMAP_GRAIN = 4096;
+
+	Vec3 ClampVec3(const Vec3& v, Real minVal = 0, Real maxVal = 1) {
+		return Vec3(
+			std::min(maxVal, std::max(minVal, v.x)),
+			std::min(maxVal, std::max(minVal, v.y)),
+			std::min(maxVal, std::max(minVal, v.z))
+		);
+	}
+
+	Vec3 uncharted2_tonemap_partial(Vec3 x)
+	{
+		float A = 0.15f;
+		float B = 0.50f;
+		float C = 0.10f;
+		float D = 0.20f;
+		float E = 0.02f;
+		float F = 0.30f;
+		return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
+	}
+
+	Vec3 aces_approx(Vec3 v)
+	{
+		v *= 0.6f;
+		float a = 2.51f;
+		float b = 0.03f;
+		float c = 2.43f;
+		float d = 0.59f;
+		float e = 0.14f;
+		return ClampVec3((v * (a * v + b)) / (v * (c * v + d) + e), 0.0f, 1.0f);
+	}
+
+	Real luminance(const Vec3& color)
+	{
+		Vec3 luminanceWeights = Vec3(Real(0.2126), Real(0.7152), Real(0.0722));
+		return color.dot(luminanceWeights);
+	}
+
+	Vec3 change_luminance(Vec3 c_in, Real l_out)
+	{
+		Real l_in = luminance(c_in);
+		return c_in * (l_out / l_in);
+	}
+
+	Color toColor(const Vec3& pixel)
+	{
+		Vec3 clamped = ClampVec3(pixel);
+		return Color(
+			static_cast<uint8_t>(clamped.x * Real(255)),
+			static_cast<uint8_t>(clamped.y * Real(255)),
+			static_cast<uint8_t>(clamped.z * Real(255))
+		);
+	}
+
+	Vec3 simple(const Vec3& color)
+	{
+		return ClampVec3(color);
+	}
+
+	Vec3 reinhardSimple(const Vec3& color) {
+		return color / (color + 1);
+	}
+
+	Vec3 reinhardExtended(const Vec3 color, Real max_white) {
+		Real white_sq = max_white * max_white;
+		Vec3 numerator = color * ((color / Vec3(white_sq, white_sq, white_sq)) + 1);
+		return numerator / (color + 1);
+	}
+
+	Vec3 reinhardExtendedLuminance(const Vec3& color, Real maxWhite) {
+		Real L_old = luminance(color);
+		Real numerator = L_old * (1 + (L_old / (maxWhite * maxWhite)));
+		Real l_new = numerator / (1 + L_old);
+		return change_luminance(color, l_new);
+	}
+
+	Vec3 reinhardJodie(const Vec3& color, Real a = Real(0.18)) {
+		Real L = luminance(color);
+		Real L_mapped = (a / std::log(2 + std::pow((L / Real(0.85)), Real(1.7)))) * std::log(1 + L);
+		return change_luminance(color, L_mapped);
+	}
+
+	// 1 / f(W) ne depend pas du pixel, calcule une fois
+	const Vec3 UNCHARTED2_WHITE_SCALE = Vec3(1, 1, 1) / uncharted2_tonemap_partial(Vec3(Real(11.2), Real(11.2), Real(11.2)));
+
+	Vec3 uncharted2(const Vec3& color) {
+		Real exposureBias = 2.0f;
+		Vec3 curr = uncharted2_tonemap_partial(color * exposureBias);
+		return curr * UNCHARTED2_WHITE_SCALE;
+	}
+
+	template <TonemapOperator OP>
+	Vec3 applyOperator(const Vec3& color)
+	{
+		if constexpr (OP == TonemapOperator::SIMPLE) {
+			return simple(color);
+		} else if constexpr (OP == TonemapOperator::REINHARD_SIMPLE) {
+			return reinhardSimple(color);
+		} else if constexpr (OP == TonemapOperator::REINHARD_EXTENDED) {
+			return reinhardExtended(color, 5.0);
+		} else if constexpr (OP == TonemapOperator::REINHARD_EXTENDED_LUMINANCE) {
+			return reinhardExtendedLuminance(color, 5.0);
+		} else if constexpr (OP == TonemapOperator::REINHARD_JODIE) {
+			return reinhardJodie(color);
+		} else if constexpr (OP == TonemapOperator::UNCHARTED2) {
+			return uncharted2(color);
+		} else {
+			return aces_approx(color);
+		}
+	}
+
+	template <TonemapOperator OP>
+	void mapRange(const Vec3* pixels, Color* output, const size_t count)
+	{
+		for (size_t i = 0; i < count; ++i) {
+			output[i] = toColor(applyOperator<OP>(pixels[i]));
+		}
+	}
+
+	// le switch est fait une fois par tranche, la boucle interne est specialisee par operateur
+	void mapRange(const TonemapOperator op, const Vec3* pixels, Color* output, const size_t count)
+	{
+		switch (op) {
+			case TonemapOperator::SIMPLE: mapRange<TonemapOperator::SIMPLE>(pixels, output, count); break;
+			case TonemapOperator::REINHARD_SIMPLE: mapRange<TonemapOperator::REINHARD_SIMPLE>(pixels, output, count); break;
+			case TonemapOperator::REINHARD_EXTENDED: mapRange<TonemapOperator::REINHARD_EXTENDED>(pixels, output, count); break;
+			case TonemapOperator::REINHARD_EXTENDED_LUMINANCE: mapRange<TonemapOperator::REINHARD_EXTENDED_LUMINANCE>(pixels, output, count); break;
+			case TonemapOperator::REINHARD_JODIE: mapRange<TonemapOperator::REINHARD_JODIE>(pixels, output, count); break;
+			case TonemapOperator::UNCHARTED2: mapRange<TonemapOperator::UNCHARTED2>(pixels, output, count); break;
+			case TonemapOperator::ACES: mapRange<TonemapOperator::ACES>(pixels, output, count); break;
+		}
+	}
+
+	// --- Noyaux float vectorises ---
+	//
+	// Une tranche est d'abord convertie en plans R, G, B float, chaque operateur travaille
+	// ensuite sur 8 (AVX2), 4 (SSE2) ou 1 pixel a la fois avec les memes formules en float.
+
+#if defined(__AVX2__)
+	struct Lanes {
+		static constexpr size_t WIDTH = 8;
+		__m256 v;
+
+		static Lanes Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+		static Lanes Set(const float s) { return { _mm256_set1_ps(s) }; }
+		void Store(float* p) const { _mm256_storeu_ps(p, v); }
+
+		friend Lanes operator+(const Lanes a, const Lanes b) { return { _mm256_add_ps(a.v, b.v) }; }
+		friend Lanes operator-(const Lanes a, const Lanes b) { return { _mm256_sub_ps(a.v, b.v) }; }
+		friend Lanes operator*(const Lanes a, const Lanes b) { return { _mm256_mul_ps(a.v, b.v) }; }
+		friend Lanes operator/(const Lanes a, const Lanes b) { return { _mm256_div_ps(a.v, b.v) }; }
+		friend Lanes Min(const Lanes a, const Lanes b) { return { _mm256_min_ps(a.v, b.v) }; }
+		// renvoie b si a est NaN, comme std::max(b, a) dans ClampVec3
+		friend Lanes Max(const Lanes a, const Lanes b) { return { _mm256_max_ps(a.v, b.v) }; }
+
+		// position dans une table indexee par les bits du float : (bits(x) - base) / 2^shift
+		static Lanes CurvePosition(const Lanes x, const int32_t base, const float scale) {
+			const __m256i offset = _mm256_sub_epi32(_mm256_castps_si256(x.v), _mm256_set1_epi32(base));
+			return { _mm256_mul_ps(_mm256_cvtepi32_ps(offset), _mm256_set1_ps(scale)) };
+		}
+
+		// interpolation lineaire de table en position pos (>= 0, < taille - 1)
+		static Lanes Lookup(const float* table, const Lanes pos) {
+			const __m256i index = _mm256_cvttps_epi32(pos.v);
+			const __m256 frac = _mm256_sub_ps(pos.v, _mm256_cvtepi32_ps(index));
+			const __m256 y0 = _mm256_i32gather_ps(table, index, 4);
+			const __m256 y1 = _mm256_i32gather_ps(table + 1, index, 4);
+			return { _mm256_add_ps(y0, _mm256_mul_ps(frac, _mm256_sub_ps(y1, y0))) };
+		}
+	};
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	struct Lanes {
+		static constexpr size_t WIDTH = 4;
+		__m128 v;
+
+		static Lanes Load(const float* p) { return { _mm_loadu_ps(p) }; }
+		static Lanes Set(const float s) { return { _mm_set1_ps(s) }; }
+		void Store(float* p) const { _mm_storeu_ps(p, v); }
+
+		friend Lanes operator+(const Lanes a, const Lanes b) { return { _mm_add_ps(a.v, b.v) }; }
+		friend Lanes operator-(const Lanes a, const Lanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+		friend Lanes operator*(const Lanes a, const Lanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+		friend Lanes operator/(const Lanes a, const Lanes b) { return { _mm_div_ps(a.v, b.v) }; }
+		friend Lanes Min(const Lanes a, const Lanes b) { return { _mm_min_ps(a.v, b.v) }; }
+		friend Lanes Max(const Lanes a, const Lanes b) { return { _mm_max_ps(a.v, b.v) }; }
+
+		static Lanes CurvePosition(const Lanes x, const int32_t base, const float scale) {
+			const __m128i offset = _mm_sub_epi32(_mm_castps_si128(x.v), _mm_set1_epi32(base));
+			return { _mm_mul_ps(_mm_cvtepi32_ps(offset), _mm_set1_ps(scale)) };
+		}
+
+		// pas de gather en SSE2 : les 4 lectures sont scalaires
+		static Lanes Lookup(const float* table, const Lanes pos) {
+			const __m128i index = _mm_cvttps_epi32(pos.v);
+			const __m128 frac = _mm_sub_ps(pos.v, _mm_cvtepi32_ps(index));
+			alignas(16) int32_t i[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(i), index);
+			const __m128 y0 = _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+			const __m128 y1 = _mm_setr_ps(table[i[0] + 1], table[i[1] + 1], table[i[2] + 1], table[i[3] + 1]);
+			return { _mm_add_ps(y0, _mm_mul_ps(frac, _mm_sub_ps(y1, y0))) };
+		}
+	};
+#else
+	struct Lanes {
+		static constexpr size_t WIDTH = 1;
+		float v;
+
+		static Lanes Load(const float* p) { return { *p }; }
+		static Lanes Set(const float s) { return { s }; }
+		void Store(float* p) const { *p = v; }
+
+		friend Lanes operator+(const Lanes a, const Lanes b) { return { a.v + b.v }; }
+		friend Lanes operator-(const Lanes a, const Lanes b) { return { a.v - b.v }; }
+		friend Lanes operator*(const Lanes a, const Lanes b) { return { a.v * b.v }; }
+		friend Lanes operator/(const Lanes a, const Lanes b) { return { a.v / b.v }; }
+		friend Lanes Min(const Lanes a, const Lanes b) { return { a.v < b.v ? a.v : b.v }; }
+		friend Lanes Max(const Lanes a, const Lanes b) { return { a.v > b.v ? a.v : b.v }; }
+
+		static Lanes CurvePosition(const Lanes x, const int32_t base, const float scale) {
+			return { static_cast<float>(std::bit_cast<int32_t>(x.v) - base) * scale };
+		}
+
+		static Lanes Lookup(const float* table, const Lanes pos) {
+			const int32_t index = static_cast<int32_t>(pos.v);
+			const float frac = pos.v - static_cast<float>(index);
+			return { table[index] + frac * (table[index + 1] - table[index]) };
+		}
+	};
+#endif
+
+	Lanes clamp01(const Lanes x)
+	{
+		return Min(Max(x, Lanes::Set(0.0f)), Lanes::Set(1.0f));
+	}
+
+	Lanes luminance(const Lanes r, const Lanes g, const Lanes b)
+	{
+		return r * Lanes::Set(0.2126f) + g * Lanes::Set(0.7152f) + b * Lanes::Set(0.0722f);
+	}
+
+	// Constantes des operateurs, hors des boucles
+	constexpr float EXTENDED_INV_WHITE_SQ = 1.0f / (5.0f * 5.0f);
+	constexpr float UNCHARTED2_EXPOSURE = 2.0f;
+	constexpr float UNCHARTED2_A = 0.15f, UNCHARTED2_B = 0.50f, UNCHARTED2_C = 0.10f;
+	constexpr float UNCHARTED2_D = 0.20f, UNCHARTED2_E = 0.02f, UNCHARTED2_F = 0.30f;
+	const float UNCHARTED2_WHITE_SCALE_F = static_cast<float>(UNCHARTED2_WHITE_SCALE.x);
+
+	template <TonemapOperator OP>
+	Lanes channelOperator(const Lanes c)
+	{
+		if constexpr (OP == TonemapOperator::SIMPLE) {
+			return c;
+		} else if constexpr (OP == TonemapOperator::REINHARD_SIMPLE) {
+			return c / (c + Lanes::Set(1.0f));
+		} else if constexpr (OP == TonemapOperator::REINHARD_EXTENDED) {
+			return c * (c * Lanes::Set(EXTENDED_INV_WHITE_SQ) + Lanes::Set(1.0f)) / (c + Lanes::Set(1.0f));
+		} else if constexpr (OP == TonemapOperator::UNCHARTED2) {
+			const Lanes x = c * Lanes::Set(UNCHARTED2_EXPOSURE);
+			const Lanes ax = Lanes::Set(UNCHARTED2_A) * x;
+			const Lanes numerator = x * (ax + Lanes::Set(UNCHARTED2_C * UNCHARTED2_B)) + Lanes::Set(UNCHARTED2_D * UNCHARTED2_E);
+			const Lanes denominator = x * (ax + Lanes::Set(UNCHARTED2_B)) + Lanes::Set(UNCHARTED2_D * UNCHARTED2_F);
+			return (numerator / denominator - Lanes::Set(UNCHARTED2_E / UNCHARTED2_F)) * Lanes::Set(UNCHARTED2_WHITE_SCALE_F);
+		} else {
+			const Lanes v = c * Lanes::Set(0.6f);
+			return (v * (Lanes::Set(2.51f) * v + Lanes::Set(0.03f))) / (v * (Lanes::Set(2.43f) * v + Lanes::Set(0.59f)) + Lanes::Set(0.14f));
+		}
+	}
+
+	constexpr bool isLuminanceOperator(const TonemapOperator op)
+	{
+		return op == TonemapOperator::REINHARD_EXTENDED_LUMINANCE || op == TonemapOperator::REINHARD_JODIE;
+	}
+
+	// --- Courbes 1D ---
+	//
+	// Chaque operateur ne depend que d'un scalaire : la valeur du canal, ou la luminance pour
+	// les deux variantes de Reinhard sur la luminance (la courbe stocke alors le facteur
+	// L_out / L_in applique aux trois canaux). Les echantillons sont espaces en progression
+	// geometrique de 2^-24 a 2^24, 64 par octave : la position dans la table se lit directement
+	// dans les bits du float (exposant + 6 premiers bits de mantisse), sans log, et l'erreur
+	// relative est la meme a toutes les echelles.
+	// A la construction, l'erreur est mesuree contre la version de reference sur une grille
+	// 16 fois plus fine ; une courbe hors tolerance n'est pas utilisee.
+
+	constexpr int CURVE_MIN_EXPONENT = -24;
+	constexpr int CURVE_MAX_EXPONENT = 24;
+	constexpr int CURVE_SEGMENT_BITS = 6; // 2^6 segments par octave
+	constexpr int CURVE_SHIFT = 23 - CURVE_SEGMENT_BITS;
+	constexpr size_t CURVE_SIZE = size_t(CURVE_MAX_EXPONENT - CURVE_MIN_EXPONENT) << CURVE_SEGMENT_BITS; // segments
+	constexpr float CURVE_MIN_INPUT = 0x1p-24f;
+	constexpr float CURVE_SCALE = 1.0f / float(1 << CURVE_SHIFT);
+	constexpr double CURVE_TOLERANCE = 1e-3; // un quart de pas 8 bits
+	const int32_t CURVE_BASE = std::bit_cast<int32_t>(CURVE_MIN_INPUT);
+	const float CURVE_MAX_INPUT = std::bit_cast<float>(CURVE_BASE + static_cast<int32_t>(CURVE_SIZE << CURVE_SHIFT));
+
+	struct Curve {
+		std::array<float, CURVE_SIZE + 1> table;
+		double maxError = 0.0;
+		bool usable = false;
+	};
+
+	// Valeur exacte (Real) que la courbe approxime
+	double curveReference(const TonemapOperator op, const double x)
+	{
+		const Real value = static_cast<Real>(x);
+		const Vec3 gray(value, value, value);
+		Vec3 mapped;
+		switch (op) {
+			case TonemapOperator::SIMPLE: mapped = applyOperator<TonemapOperator::SIMPLE>(gray); break;
+			case TonemapOperator::REINHARD_SIMPLE: mapped = applyOperator<TonemapOperator::REINHARD_SIMPLE>(gray); break;
+			case TonemapOperator::REINHARD_EXTENDED: mapped = applyOperator<TonemapOperator::REINHARD_EXTENDED>(gray); break;
+			case TonemapOperator::REINHARD_EXTENDED_LUMINANCE: mapped = applyOperator<TonemapOperator::REINHARD_EXTENDED_LUMINANCE>(gray); break;
+			case TonemapOperator::REINHARD_JODIE: mapped = applyOperator<TonemapOperator::REINHARD_JODIE>(gray); break;
+			case TonemapOperator::UNCHARTED2: mapped = applyOperator<TonemapOperator::UNCHARTED2>(gray); break;
+			case TonemapOperator::ACES: mapped = applyOperator<TonemapOperator::ACES>(gray); break;
+		}
+		if (isLuminanceOperator(op)) {
+			// un gris a pour luminance sa valeur
+			return static_cast<double>(mapped.x) / static_cast<double>(value);
+		}
+		return std::clamp(static_cast<double>(mapped.x), 0.0, 1.0);
+	}
+
+	// Entree correspondant a la position pos de la table, meme decoupage que Lanes::CurvePosition
+	double curveInput(const double pos)
+	{
+		const double index = std::floor(pos);
+		const float start = std::bit_cast<float>(CURVE_BASE + (static_cast<int32_t>(index) << CURVE_SHIFT));
+		const float end = std::bit_cast<float>(CURVE_BASE + (static_cast<int32_t>(index + 1) << CURVE_SHIFT));
+		return start + (pos - index) * (static_cast<double>(end) - start);
+	}
+
+	Curve buildCurve(const TonemapOperator op)
+	{
+		Curve curve;
+		for (size_t i = 0; i <= CURVE_SIZE; ++i) {
+			curve.table[i] = static_cast<float>(curveReference(op, curveInput(static_cast<double>(i))));
+		}
+
+		constexpr size_t REFINE = 16;
+		for (size_t i = 0; i < CURVE_SIZE * REFINE; ++i) {
+			const double pos = static_cast<double>(i) / REFINE;
+			const size_t index = i / REFINE;
+			const double approx = curve.table[index] + (pos - index) * (curve.table[index + 1] - curve.table[index]);
+			const double exact = curveReference(op, curveInput(pos));
+			const double error = isLuminanceOperator(op) ? std::abs(approx / exact - 1.0) : std::abs(std::clamp(approx, 0.0, 1.0) - exact);
+			curve.maxError = std::max(curve.maxError, error);
+		}
+		curve.usable = curve.maxError <= CURVE_TOLERANCE;
+		return curve;
+	}
+
+	const Curve& curveFor(const TonemapOperator op)
+	{
+		static const std::array<Curve, std::size(ALL_TONEMAP_OPERATORS)> curves = [] {
+			std::array<Curve, std::size(ALL_TONEMAP_OPERATORS)> built;
+			for (const TonemapOperator candidate : ALL_TONEMAP_OPERATORS) {
+				built[static_cast<size_t>(candidate)] = buildCurve(candidate);
+			}
+			return built;
+		}();
+		return curves[static_cast<size_t>(op)];
+	}
+
+	// Sous 2^-24 la valeur est prise au bord ; les entrees au-dela de 2^24 n'arrivent pas ici
+	// (voir inKernelDomain), la borne haute ne sert qu'a rester dans la table
+	Lanes evaluateCurve(const Curve& curve, const Lanes x)
+	{
+		const Lanes clamped = Min(Max(x, Lanes::Set(CURVE_MIN_INPUT)), Lanes::Set(CURVE_MAX_INPUT));
+		const Lanes pos = Min(Lanes::CurvePosition(clamped, CURVE_BASE, CURVE_SCALE), Lanes::Set(static_cast<float>(CURVE_SIZE) - 0.001f));
+		return Lanes::Lookup(curve.table.data(), pos);
+	}
+
+	// Domaine ou les noyaux float suivent la reference. Au-dela de 2^24 le facteur L_out / L_in
+	// des courbes sur la luminance est fige alors que la couleur continue de croitre, les
+	// polynomes d'Uncharted 2 et ACES debordent en float (inf / inf), et les negatifs, infinis
+	// et NaN donnent avec la courbe un autre resultat que les formules : ces pixels sont
+	// recalcules avec la reference.
+	bool inKernelDomain(const float value)
+	{
+		return value >= 0.0f && value <= CURVE_MAX_INPUT;
+	}
+
+	// Plans float d'une tranche : entree R, G, B puis sortie R, G, B, et les pixels hors domaine
+	struct SlicePlanes {
+		std::vector<float> data;
+		std::vector<size_t> outside;
+		size_t stride = 0;
+
+		void Reserve(const size_t count) {
+			// arrondi a la largeur des lanes pour que la derniere iteration puisse deborder
+			stride = (count + Lanes::WIDTH - 1) / Lanes::WIDTH * Lanes::WIDTH;
+			if (data.size() < stride * 6) {
+				data.assign(stride * 6, 0.0f);
+			}
+		}
+		float* Plane(const size_t index) { return data.data() + index * stride; }
+	};
+
+	template <TonemapOperator OP>
+	void mapSliceSimd(SlicePlanes& planes, const size_t count, const bool useCurve)
+	{
+		const float* inR = planes.Plane(0);
+		const float* inG = planes.Plane(1);
+		const float* inB = planes.Plane(2);
+		float* outR = planes.Plane(3);
+		float* outG = planes.Plane(4);
+		float* outB = planes.Plane(5);
+		const Curve* curve = useCurve ? &curveFor(OP) : nullptr;
+
+		for (size_t i = 0; i < count; i += Lanes::WIDTH) {
+			const Lanes r = Lanes::Load(inR + i);
+			const Lanes g = Lanes::Load(inG + i);
+			const Lanes b = Lanes::Load(inB + i);
+			Lanes mappedR, mappedG, mappedB;
+			if constexpr (isLuminanceOperator(OP)) {
+				const Lanes lum = luminance(r, g, b);
+				Lanes scale;
+				if (curve) {
+					scale = evaluateCurve(*curve, lum);
+				} else {
+					// seul REINHARD_EXTENDED_LUMINANCE arrive ici, Jodie passe toujours par sa courbe
+					const Lanes mappedLum = lum * (Lanes::Set(1.0f) + lum * Lanes::Set(EXTENDED_INV_WHITE_SQ)) / (Lanes::Set(1.0f) + lum);
+					scale = mappedLum / lum;
+				}
+				mappedR = r * scale;
+				mappedG = g * scale;
+				mappedB = b * scale;
+			} else if (curve) {
+				mappedR = evaluateCurve(*curve, r);
+				mappedG = evaluateCurve(*curve, g);
+				mappedB = evaluateCurve(*curve, b);
+			} else {
+				mappedR = channelOperator<OP>(r);
+				mappedG = channelOperator<OP>(g);
+				mappedB = channelOperator<OP>(b);
+			}
+			clamp01(mappedR).Store(outR + i);
+			clamp01(mappedG).Store(outG + i);
+			clamp01(mappedB).Store(outB + i);
+		}
+	}
+
+	// Renvoie false si l'operateur doit passer par la reference (courbe hors tolerance)
+	bool mapSliceSimd(const TonemapOperator op, SlicePlanes& planes, const size_t count, bool useCurve)
+	{
+		if (op == TonemapOperator::REINHARD_JODIE) {
+			// log et pow n'ont pas de version vectorielle ici, Jodie passe par sa courbe
+			useCurve = true;
+		}
+		if (useCurve && !curveFor(op).usable) {
+			if (op == TonemapOperator::REINHARD_JODIE) {
+				return false;
+			}
+			useCurve = false;
+		}
+
+		switch (op) {
+			case TonemapOperator::SIMPLE: mapSliceSimd<TonemapOperator::SIMPLE>(planes, count, useCurve); break;
+			case TonemapOperator::REINHARD_SIMPLE: mapSliceSimd<TonemapOperator::REINHARD_SIMPLE>(planes, count, useCurve); break;
+			case TonemapOperator::REINHARD_EXTENDED: mapSliceSimd<TonemapOperator::REINHARD_EXTENDED>(planes, count, useCurve); break;
+			case TonemapOperator::REINHARD_EXTENDED_LUMINANCE: mapSliceSimd<TonemapOperator::REINHARD_EXTENDED_LUMINANCE>(planes, count, useCurve); break;
+			case TonemapOperator::REINHARD_JODIE: mapSliceSimd<TonemapOperator::REINHARD_JODIE>(planes, count, useCurve); break;
+			case TonemapOperator::UNCHARTED2: mapSliceSimd<TonemapOperator::UNCHARTED2>(planes, count, useCurve); break;
+			case TonemapOperator::ACES: mapSliceSimd<TonemapOperator::ACES>(planes, count, useCurve); break;
+		}
+		return true;
+	}
+
+	// Tranche [begin, begin + count) : conversion en plans float, puis chaque operateur
+	// ecrit ses plans de sortie et les entrelace dans le buffer de l'appelant
+	void tonemapSliceSimd(std::span<const Vec3> pixels, const size_t begin, const size_t count, std::span<const TonemapTarget> targets, const bool useCurve)
+	{
+		thread_local SlicePlanes planes;
+		planes.Reserve(count);
+		planes.outside.clear();
+		float* inR = planes.Plane(0);
+		float* inG = planes.Plane(1);
+		float* inB = planes.Plane(2);
+		for (size_t i = 0; i < count; ++i) {
+			const Vec3& pixel = pixels[begin + i];
+			inR[i] = static_cast<float>(pixel.x);
+			inG[i] = static_cast<float>(pixel.y);
+			inB[i] = static_cast<float>(pixel.z);
+			if (!inKernelDomain(inR[i]) || !inKernelDomain(inG[i]) || !inKernelDomain(inB[i])) {
+				// noir dans les plans pour que les lanes restent finies, remplace ensuite
+				planes.outside.push_back(i);
+				inR[i] = inG[i] = inB[i] = 0.0f;
+			}
+		}
+
+		const float* outR = planes.Plane(3);
+		const float* outG = planes.Plane(4);
+		const float* outB = planes.Plane(5);
+		for (const TonemapTarget& target : targets) {
+			Color* output = target.output.data() + begin;
+			if (!mapSliceSimd(target.op, planes, count, useCurve)) {
+				mapRange(target.op, pixels.data() + begin, output, count);
+				continue;
+			}
+			for (size_t i = 0; i < count; ++i) {
+				output[i] = Color(
+					static_cast<uint8_t>(outR[i] * 255.0f),
+					static_cast<uint8_t>(outG[i] * 255.0f),
+					static_cast<uint8_t>(outB[i] * 255.0f));
+			}
+			for (const size_t i : planes.outside) {
+				mapRange(target.op, pixels.data() + begin + i, output + i, 1);
+			}
+		}
+	}
+}
+
+const char* tonemapName(const TonemapOperator op)
+{
+	switch (op) {
+		case TonemapOperator::SIMPLE: return "simple";
+		case TonemapOperator::REINHARD_SIMPLE: return "reinhard_simple";
+		case TonemapOperator::REINHARD_EXTENDED: return "reinhard_extended";
+		case TonemapOperator::REINHARD_EXTENDED_LUMINANCE: return "reinhard_extended_luminance";
+		case TonemapOperator::REINHARD_JODIE: return "reinhard_jodie";
+		case TonemapOperator::UNCHARTED2: return "uncharted2";
+		case TonemapOperator::ACES: return "aces";
+	}
+	return "unknown";
+}
+
+Color tonemapPixel(const TonemapOperator op, const Vec3& color)
+{
+	Color result;
+	mapRange(op, &color, &result, 1);
+	return result;
+}
+
+double tonemapCurveError(const TonemapOperator op)
+{
+	return curveFor(op).maxError;
+}
+
+int tonemapMaxLevelError(const TonemapOperator op, const TonemapKernel kernel, ThreadPool& pool)
+{
+	// un float sur 2^12 (32 par segment de courbe) de +0 a +inf puis de -0 a -inf, et les cas limites
+	constexpr uint32_t SWEEP_STEP = 1u << 12;
+	constexpr uint32_t INFINITY_BITS = 0x7f800000u;
+	std::vector<float> values;
+	for (const uint32_t sign : { 0u, 0x80000000u }) {
+		for (uint32_t bits = 0; bits <= INFINITY_BITS; bits += SWEEP_STEP) {
+			values.push_back(std::bit_cast<float>(sign | bits));
+		}
+	}
+	values.push_back(std::numeric_limits<float>::denorm_min());
+	values.push_back(std::numeric_limits<float>::max());
+	values.push_back(std::numeric_limits<float>::quiet_NaN());
+	values.push_back(-std::numeric_limits<float>::quiet_NaN());
+
+	// chaque valeur en gris, puis seule sur un canal, les autres a 0 ou a 0.5
+	constexpr size_t SHAPES = 7;
+	constexpr size_t CHUNK = size_t(1) << 16;
+	std::vector<Vec3> pixels;
+	std::vector<Color> reference(CHUNK * SHAPES);
+	std::vector<Color> output(CHUNK * SHAPES);
+	int maxError = 0;
+	for (size_t first = 0; first < values.size(); first += CHUNK) {
+		pixels.clear();
+		for (size_t i = first; i < std::min(values.size(), first + CHUNK); ++i) {
+			const Real v = static_cast<Real>(values[i]);
+			const Real half = Real(0.5);
+			pixels.insert(pixels.end(), {
+				Vec3(v, v, v),
+				Vec3(v, 0, 0), Vec3(0, v, 0), Vec3(0, 0, v),
+				Vec3(v, half, half), Vec3(half, v, half), Vec3(half, half, v),
+			});
+		}
+		const TonemapTarget referenceTarget{ op, reference };
+		const TonemapTarget target{ op, output };
+		tonemap(pixels, { &referenceTarget, 1 }, TonemapKernel::REFERENCE, pool);
+		tonemap(pixels, { &target, 1 }, kernel, pool);
+		for (size_t i = 0; i < pixels.size(); ++i) {
+			maxError = std::max({ maxError,
+				std::abs(int(output[i].r) - int(reference[i].r)),
+				std::abs(int(output[i].g) - int(reference[i].g)),
+				std::abs(int(output[i].b) - int(reference[i].b)) });
+		}
+	}
+	return maxError;
+}
+
+void tonemap(std::span<const Vec3> pixels, std::span<const TonemapTarget> targets, const TonemapKernel kernel, ThreadPool& pool)
+{
+	TRACE_SCOPE("tonemap", "output");
+	for (const TonemapTarget& target : targets) {
+		if (target.output.size() < pixels.size()) {
+			throw std::runtime_error("Tonemap output buffer smaller than image");
+		}
+	}
+
+	pool.ParallelFor(0, pixels.size(), TONEMAP_GRAIN, [&](const size_t begin, const size_t end) {
+		if (kernel == TonemapKernel::REFERENCE) {
+			for (const TonemapTarget& target : targets) {
+				mapRange(target.op, pixels.data() + begin, target.output.data() + begin, end - begin);
+			}
+		} else {
+			tonemapSliceSimd(pixels, begin, end - begin, targets, kernel == TonemapKernel::CURVE);
+		}
+	});
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include "Math.h"
+#include "ThreadPool.h"
+
+enum class TonemapOperator {
+	SIMPLE,                      // simple clamp dans [0, 1]
+	REINHARD_SIMPLE,
+	REINHARD_EXTENDED,           // blanc a 5
+	REINHARD_EXTENDED_LUMINANCE, // idem sur la luminance, teinte conservee
+	REINHARD_JODIE,
+	UNCHARTED2,
+	ACES,                        // approximation de Narkowicz
+};
+
+inline constexpr TonemapOperator ALL_TONEMAP_OPERATORS[] = {
+	TonemapOperator::SIMPLE,
+	TonemapOperator::REINHARD_SIMPLE,
+	TonemapOperator::REINHARD_EXTENDED,
+	TonemapOperator::REINHARD_EXTENDED_LUMINANCE,
+	TonemapOperator::REINHARD_JODIE,
+	TonemapOperator::UNCHARTED2,
+	TonemapOperator::ACES,
+};
+
+enum class TonemapKernel {
+	REFERENCE, // formules d'origine en Real, pixel par pixel
+	SIMD,      // memes formules en float sur 8 (AVX2) ou 4 (SSE2) pixels ; Jodie passe par sa courbe
+	CURVE,     // courbes 1D precalculees pour tous les operateurs, interpolees lineairement
+};
+
+// Nom court de l'operateur, utilise pour les fichiers de sortie
+const char* tonemapName(TonemapOperator op);
+
+// Un operateur demande et le buffer ou ecrire son resultat, fourni par l'appelant
+struct TonemapTarget {
+	TonemapOperator op;
+	std::span<Color> output; // au moins autant de pixels que l'entree
+};
+
+// Version de reference, pixel par pixel
+Color tonemapPixel(TonemapOperator op, const Vec3& color);
+
+// Ecart maximal mesure a la construction entre la courbe de l'operateur et la reference :
+// absolu sur la sortie [0, 1] pour les operateurs par canal, relatif sur le facteur
+// L_out / L_in pour ceux sur la luminance. Au-dela de 1e-3 la courbe n'est pas utilisee.
+double tonemapCurveError(TonemapOperator op);
+
+// Ecart maximal, en niveaux sur 255, entre le noyau et la reference sur tout l'intervalle des
+// float (un sur 4096, negatifs, 0, infinis et NaN compris), en pixels gris et colores
+int tonemapMaxLevelError(TonemapOperator op, TonemapKernel kernel, ThreadPool& pool = ThreadPool::Global());
+
+// Applique tous les operateurs demandes en une seule lecture du buffer HDR : l'image est
+// decoupee en tranches sur le pool, chaque tranche reste en cache pendant que tous les
+// operateurs l'ecrivent dans leur buffer. SIMD et CURVE different de la reference d'au plus
+// un niveau sur 255 (verifie par tonemapMaxLevelError) ; les pixels dont un canal est negatif,
+// au-dela de 2^24, infini ou NaN passent par la reference.
+void tonemap(std::span<const Vec3> pixels, std::span<const TonemapTarget> targets,
+	TonemapKernel kernel = TonemapKernel::SIMD, ThreadPool& pool = ThreadPool::Global());
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Chronologie des etapes du programme (chargement, construction des BVH, tuiles par thread, tonemapping,
+// ecriture des images) au format Chrome trace-event, a ouvrir dans Perfetto ou chrome://tracing.
+// Active a l'execution entre Start et Stop ; desactive, un TRACE_SCOPE coute une lecture atomique.
+struct TraceEvent {
+    const char* name = nullptr;     // chaines litterales, jamais copiees
+    const char* category = nullptr;
+    int64_t startNs = 0;            // depuis Tracer::Start
+    int64_t durationNs = 0;
+    std::array<const char*, 2> argNames{};
+    std::array<int64_t, 2> argValues{};
+};
+
+// Comme Stats, chaque thread ajoute ses evenements a son propre buffer sans synchronisation ;
+// les buffers sont enregistres a leur creation et fusionnes par Write une fois le travail termine.
+class Tracer {
+private:
+    struct ThreadBuffer {
+        uint32_t id = 0;
+        std::string name;
+        std::vector<TraceEvent> events;
+    };
+
+    static inline std::atomic<bool> enabled{ false };
+    static inline std::chrono::steady_clock::time_point origin;
+    static inline int64_t heavyPixelNs = 0;
+    static inline std::mutex registryMutex;
+    static inline std::vector<std::unique_ptr<ThreadBuffer>> registry;
+    static inline thread_local ThreadBuffer* local = nullptr;
+
+    static ThreadBuffer& Local() {
+        if (!local) {
+            const std::lock_guard lock(registryMutex);
+            registry.push_back(std::make_unique<ThreadBuffer>());
+            registry.back()->id = static_cast<uint32_t>(registry.size());
+            local = registry.back().get();
+        }
+        return *local;
+    }
+
+    // Noms de threads et d'evenements echappes pour rester du JSON valide (guillemets, \, controles)
+    static std::string JsonEscape(const std::string_view text) {
+        static constexpr char HEX[] = "0123456789abcdef";
+        std::string escaped;
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                escaped += "\\u00";
+                escaped += HEX[(c >> 4) & 0xf];
+                escaped += HEX[c & 0xf];
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+public:
+    // Vide les evenements precedents. Les pixels (ou paquets de pixels) plus longs que
+    // heavyPixelMs ont leur propre span, imbrique dans celui de leur tuile.
+    static void Start(const double heavyPixelMs = 1.0) {
+        {
+            const std::lock_guard lock(registryMutex);
+            for (const auto& buffer : registry) {
+                buffer->events.clear();
+            }
+        }
+        heavyPixelNs = static_cast<int64_t>(heavyPixelMs * 1e6);
+        origin = std::chrono::steady_clock::now();
+        enabled.store(true, std::memory_order_release);
+    }
+
+    static void Stop() { enabled.store(false, std::memory_order_release); }
+
+    static bool Enabled() { return enabled.load(std::memory_order_acquire); }
+
+    static int64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    // Nom affiche pour la ligne du thread courant ("main", "worker 3"...)
+    static void SetThreadName(std::string name) {
+        Local().name = std::move(name);
+    }
+
+    static void Record(const TraceEvent& event) {
+        if (Enabled()) {
+            Local().events.push_back(event);
+        }
+    }
+
+    // Span commence a startNs, garde seulement s'il depasse le seuil des pixels lourds
+    static void RecordHeavy(const char* name, const int64_t startNs, const int64_t x, const int64_t y) {
+        const int64_t durationNs = Now() - startNs;
+        if (durationNs >= heavyPixelNs) {
+            Record({ name, "pixel", startNs, durationNs, { "x", "y" }, { x, y } });
+        }
+    }
+
+    // A appeler hors rendu, comme Stats::Collect : les threads ne doivent plus ajouter d'evenements
+    static void Write(const std::string& filename) {
+        std::ofstream out(filename);
+        if (!out) {
+            throw std::runtime_error("Could not open file for writing");
+        }
+
+        const std::lock_guard lock(registryMutex);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        const auto separator = [&] {
+            out << (first ? "\n" : ",\n");
+            first = false;
+        };
+        out << std::fixed << std::setprecision(3);
+        for (const auto& buffer : registry) {
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+                << ",\"args\":{\"name\":\"" << (buffer->name.empty() ? "thread " + std::to_string(buffer->id) : JsonEscape(buffer->name)) << "\"}}";
+            for (const TraceEvent& event : buffer->events) {
+                separator();
+                // les horodatages sont en microsecondes
+                out << "{\"name\":\"" << JsonEscape(event.name) << "\",\"cat\":\"" << JsonEscape(event.category) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+                    << ",\"ts\":" << static_cast<double>(event.startNs) * 1e-3 << ",\"dur\":" << static_cast<double>(event.durationNs) * 1e-3;
+                if (event.argNames[0]) {
+                    out << ",\"args\":{\"" << JsonEscape(event.argNames[0]) << "\":" << event.argValues[0];
+                    if (event.argNames[1]) {
+                        out << ",\"" << JsonEscape(event.argNames[1]) << "\":" << event.argValues[1];
+                    }
+                    out << "}";
+                }
+                out << "}";
+            }
+        }
+        out << "\n]}\n";
+    }
+};
+
+// Span couvrant la duree de vie de l'objet, enregistre a la destruction sur le thread courant
+class TraceScope {
+private:
+    TraceEvent event;
+    bool active;
+
+public:
+    explicit TraceScope(const char* name, const char* category = "render",
+        const char* argName0 = nullptr, const int64_t argValue0 = 0,
+        const char* argName1 = nullptr, const int64_t argValue1 = 0) : active(Tracer::Enabled()) {
+        if (active) {
+            event.name = name;
+            event.category = category;
+            event.argNames = { argName0, argName1 };
+            event.argValues = { argValue0, argValue1 };
+            event.startNs = Tracer::Now();
+        }
+    }
+    ~TraceScope() {
+        if (active) {
+            event.durationNs = Tracer::Now() - event.startNs;
+            Tracer::Record(event);
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// TRACE_SCOPE("nom"[, "categorie"[, "arg", valeur[, "arg", valeur]]])
+#define TRACE_SCOPE(...) const TraceScope TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
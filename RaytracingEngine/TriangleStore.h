@@ -0,0 +1,209 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <bit>
+#include "Math.h"
+#include "Stats.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Triangles stockes en structure de tableaux (SoA) par leurs trois sommets en simple precision.
+// Chaque composante a son propre plan, le noyau teste 8 triangles par instruction en AVX2 ;
+// sans AVX2 une boucle scalaire prend le relais.
+// Le test est celui, etanche, de Woop, Benthin et Wald (JCGT 2013) : le rayon est cisaille
+// pour qu'une arete partagee soit evaluee a l'identique depuis ses deux triangles et qu'aucun
+// rayon ne passe entre eux, ce que Moller-Trumbore en simple precision ne garantit pas.
+class TriangleStore {
+private:
+    static constexpr int LANES = 8;
+    static constexpr float EPSILON = 1e-6f;
+
+    enum Plane { V0X, V0Y, V0Z, V1X, V1Y, V1Z, V2X, V2Y, V2Z, PLANE_COUNT };
+
+    std::vector<float> data;
+    size_t count = 0;
+    size_t stride = 0; // count arrondi, plus un bloc, pour toujours pouvoir charger 8 lanes
+
+    float* plane(const int p) noexcept { return data.data() + p * stride; }
+    const float* plane(const int p) const noexcept { return data.data() + p * stride; }
+
+    // Constantes de cisaillement du rayon, kz est l'axe dominant de la direction
+    struct RayData {
+        int kx, ky, kz;
+        float ox, oy, oz; // origine permutee en (kx, ky, kz)
+        float sx, sy, sz;
+
+        explicit RayData(const Rayon& ray) {
+            const float d[3] = { static_cast<float>(ray.direction.x), static_cast<float>(ray.direction.y), static_cast<float>(ray.direction.z) };
+            const float o[3] = { static_cast<float>(ray.origin.x), static_cast<float>(ray.origin.y), static_cast<float>(ray.origin.z) };
+            kz = std::abs(d[0]) > std::abs(d[1]) ? (std::abs(d[0]) > std::abs(d[2]) ? 0 : 2) : (std::abs(d[1]) > std::abs(d[2]) ? 1 : 2);
+            kx = (kz + 1) % 3;
+            ky = (kx + 1) % 3;
+            if (d[kz] < 0.0f) {
+                std::swap(kx, ky); // garde le sens de parcours du triangle cisaille
+            }
+            ox = o[kx];
+            oy = o[ky];
+            oz = o[kz];
+            sx = d[kx] / d[kz];
+            sy = d[ky] / d[kz];
+            sz = 1.0f / d[kz];
+        }
+    };
+
+    float IntersectScalar(const RayData& r, const size_t i) const noexcept {
+        const float akz = plane(V0X + r.kz)[i] - r.oz;
+        const float bkz = plane(V1X + r.kz)[i] - r.oz;
+        const float ckz = plane(V2X + r.kz)[i] - r.oz;
+        const float ax = plane(V0X + r.kx)[i] - r.ox - r.sx * akz;
+        const float ay = plane(V0X + r.ky)[i] - r.oy - r.sy * akz;
+        const float bx = plane(V1X + r.kx)[i] - r.ox - r.sx * bkz;
+        const float by = plane(V1X + r.ky)[i] - r.oy - r.sy * bkz;
+        const float cx = plane(V2X + r.kx)[i] - r.ox - r.sx * ckz;
+        const float cy = plane(V2X + r.ky)[i] - r.oy - r.sy * ckz;
+
+        const float u = cx * by - cy * bx;
+        const float v = ax * cy - ay * cx;
+        const float w = bx * ay - by * ax;
+        if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) { return -1.0f; }
+
+        const float det = u + v + w;
+        if (det == 0.0f) { return -1.0f; }
+
+        const float t = (u * r.sz * akz + v * r.sz * bkz + w * r.sz * ckz) / det;
+        return t > EPSILON ? t : -1.0f;
+    }
+
+#if defined(__AVX2__)
+    // Distances d'impact des triangles [base, base + 8) et masque des lanes touchees dans ]tMin, tMax[
+    int IntersectBlock(const RayData& r, const size_t base, const int lanes, const float tMin, const float tMax, __m256& tOut) const noexcept {
+        const __m256 ox = _mm256_set1_ps(r.ox), oy = _mm256_set1_ps(r.oy), oz = _mm256_set1_ps(r.oz);
+        const __m256 sx = _mm256_set1_ps(r.sx), sy = _mm256_set1_ps(r.sy), sz = _mm256_set1_ps(r.sz);
+
+        const __m256 akz = _mm256_sub_ps(_mm256_loadu_ps(plane(V0X + r.kz) + base), oz);
+        const __m256 bkz = _mm256_sub_ps(_mm256_loadu_ps(plane(V1X + r.kz) + base), oz);
+        const __m256 ckz = _mm256_sub_ps(_mm256_loadu_ps(plane(V2X + r.kz) + base), oz);
+        const __m256 ax = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(plane(V0X + r.kx) + base), ox), _mm256_mul_ps(sx, akz));
+        const __m256 ay = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(plane(V0X + r.ky) + base), oy), _mm256_mul_ps(sy, akz));
+        const __m256 bx = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(plane(V1X + r.kx) + base), ox), _mm256_mul_ps(sx, bkz));
+        const __m256 by = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(plane(V1X + r.ky) + base), oy), _mm256_mul_ps(sy, bkz));
+        const __m256 cx = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(plane(V2X + r.kx) + base), ox), _mm256_mul_ps(sx, ckz));
+        const __m256 cy = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(plane(V2X + r.ky) + base), oy), _mm256_mul_ps(sy, ckz));
+
+        const __m256 u = _mm256_sub_ps(_mm256_mul_ps(cx, by), _mm256_mul_ps(cy, bx));
+        const __m256 v = _mm256_sub_ps(_mm256_mul_ps(ax, cy), _mm256_mul_ps(ay, cx));
+        const __m256 w = _mm256_sub_ps(_mm256_mul_ps(bx, ay), _mm256_mul_ps(by, ax));
+        const __m256 det = _mm256_add_ps(u, _mm256_add_ps(v, w));
+        const __m256 scaledT = _mm256_add_ps(_mm256_mul_ps(u, _mm256_mul_ps(sz, akz)),
+            _mm256_add_ps(_mm256_mul_ps(v, _mm256_mul_ps(sz, bkz)), _mm256_mul_ps(w, _mm256_mul_ps(sz, ckz))));
+        const __m256 t = _mm256_div_ps(scaledT, det);
+
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 allPositive = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(v, zero, _CMP_GE_OQ)), _mm256_cmp_ps(w, zero, _CMP_GE_OQ));
+        const __m256 allNegative = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_LE_OQ), _mm256_cmp_ps(v, zero, _CMP_LE_OQ)), _mm256_cmp_ps(w, zero, _CMP_LE_OQ));
+        __m256 mask = _mm256_or_ps(allPositive, allNegative);
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, _mm256_set1_ps(std::max(tMin, EPSILON)), _CMP_GT_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LT_OQ));
+
+        tOut = t;
+        return _mm256_movemask_ps(mask) & ((1 << lanes) - 1);
+    }
+#endif
+
+public:
+    // Reconstruit les plans a partir des sommets (v0, v1, v2) fournis par le callback pour i dans [0, triangleCount)
+    template <typename TriangleFn>
+    void Build(const size_t triangleCount, TriangleFn&& getTriangle) {
+        count = triangleCount;
+        stride = (triangleCount + LANES - 1) / LANES * LANES + LANES;
+        data.assign(PLANE_COUNT * stride, 0.0f);
+        for (size_t i = 0; i < triangleCount; ++i) {
+            const auto [v0, v1, v2] = getTriangle(i);
+            const Vec3* vertices[3] = { &v0, &v1, &v2 };
+            for (int vertex = 0; vertex < 3; ++vertex) {
+                plane(V0X + vertex * 3)[i] = static_cast<float>(vertices[vertex]->x);
+                plane(V0Y + vertex * 3)[i] = static_cast<float>(vertices[vertex]->y);
+                plane(V0Z + vertex * 3)[i] = static_cast<float>(vertices[vertex]->z);
+            }
+        }
+    }
+
+    size_t Size() const noexcept { return count; }
+
+    // Impact le plus proche dans [first, first + rangeCount) avant tMax, met a jour tMax et hitSlot
+    bool IntersectRange(const Rayon& ray, const uint32_t first, const uint32_t rangeCount, Real& tMax, uint32_t& hitSlot) const noexcept {
+        const RayData r(ray);
+        float closest = static_cast<float>(std::min(tMax, static_cast<Real>(std::numeric_limits<float>::max())));
+        bool hit = false;
+        Stats::CountTests(ShapeKind::TRIANGLE, rangeCount);
+
+#if defined(__AVX2__)
+        for (uint32_t offset = 0; offset < rangeCount; offset += LANES) {
+            const int lanes = static_cast<int>(std::min<uint32_t>(LANES, rangeCount - offset));
+            __m256 t;
+            int mask = IntersectBlock(r, first + offset, lanes, EPSILON, closest, t);
+            if (mask == 0) {
+                continue;
+            }
+            alignas(32) float distances[LANES];
+            _mm256_store_ps(distances, t);
+            while (mask != 0) {
+                const int lane = std::countr_zero(static_cast<unsigned>(mask));
+                mask &= mask - 1;
+                if (distances[lane] < closest) {
+                    closest = distances[lane];
+                    hitSlot = first + offset + lane;
+                    hit = true;
+                }
+            }
+        }
+#else
+        for (uint32_t i = first; i < first + rangeCount; ++i) {
+            if (const float t = IntersectScalar(r, i); t > 0.0f && t < closest) {
+                closest = t;
+                hitSlot = i;
+                hit = true;
+            }
+        }
+#endif
+
+        // la comparaison en float peut accepter un impact d'une erreur d'arrondi derriere tMax
+        if (!hit || static_cast<Real>(closest) >= tMax) {
+            return false;
+        }
+        tMax = closest;
+        return true;
+    }
+
+    // Vrai si un triangle de [first, first + rangeCount) est touche dans ]minDist, maxDist[
+    bool IntersectRangeAny(const Rayon& ray, const uint32_t first, const uint32_t rangeCount, const Real minDist, const Real maxDist) const noexcept {
+        const RayData r(ray);
+        const float start = std::max(static_cast<float>(minDist), 0.0f);
+        const float limit = static_cast<float>(std::min(maxDist, static_cast<Real>(std::numeric_limits<float>::max())));
+
+#if defined(__AVX2__)
+        for (uint32_t offset = 0; offset < rangeCount; offset += LANES) {
+            const int lanes = static_cast<int>(std::min<uint32_t>(LANES, rangeCount - offset));
+            __m256 t;
+            Stats::CountTests(ShapeKind::TRIANGLE, static_cast<uint64_t>(lanes));
+            if (IntersectBlock(r, first + offset, lanes, start, limit, t) != 0) {
+                return true;
+            }
+        }
+#else
+        for (uint32_t i = first; i < first + rangeCount; ++i) {
+            Stats::CountTests(ShapeKind::TRIANGLE);
+            if (const float t = IntersectScalar(r, i); t > start && t < limit) {
+                return true;
+            }
+        }
+#endif
+        return false;
+    }
+};